@@ -32,10 +32,18 @@ namespace opti_init
 			static constexpr int bit_index = bit;
 			static constexpr int bit_mask = (1 << bit);
 
-			using input_any  = modifier< ptr_direction, bit_mask, 0 >;
-			using output_any = modifier< ptr_direction, bit_mask, bit_mask >;
-			using low  = modifier< ptr_value, bit_mask, 0 >;
-			using high = modifier< ptr_value, bit_mask, bit_mask >;
+			// register addresses, e.g. for pin_set
+			static constexpr pointer_int_t direction_address = ptr_direction;
+			static constexpr pointer_int_t value_address = ptr_value;
+			static constexpr pointer_int_t read_address = ptr_read;
+
+			// DDRx and PORTx are cleared on reset on every attiny/atmega
+			using reset_traits = known_reset<0>;
+
+			using input_any  = modifier< ptr_direction, bit_mask, 0, reset_traits >;
+			using output_any = modifier< ptr_direction, bit_mask, bit_mask, reset_traits >;
+			using low  = modifier< ptr_value, bit_mask, 0, reset_traits >;
+			using high = modifier< ptr_value, bit_mask, bit_mask, reset_traits >;
 
 			using output_low = list< low, output_any >;
 			using output_high = list< high, output_any >;
@@ -46,8 +54,13 @@ namespace opti_init
 			using input = input_floating;
 			using output = output_any;
 
-			using ddr_register_bit = peripheral_register_bit<ptr_direction, bit>;
-			using port_register_bit = peripheral_register_bit<ptr_value, bit>;
+		#if OPTI_INIT_PIN_TOGGLE
+			// writing one to PINx toggles PORTx bit
+			using toggle = modifier< ptr_read, bit_mask, bit_mask, toggle_register >;
+		#endif
+
+			using ddr_register_bit = peripheral_register_bit<ptr_direction, bit, reset_traits>;
+			using port_register_bit = peripheral_register_bit<ptr_value, bit, reset_traits>;
 			using pin_register_bit = peripheral_register_bit<ptr_read, bit>;
 
 			template <bool value>
@@ -55,6 +68,9 @@ namespace opti_init
 
 			static bool get_f() { return pin_register_bit::get_f(); }
 			static void set_f(bool value) { port_register_bit::set_f(value); }
+		#if OPTI_INIT_PIN_TOGGLE
+			static void toggle_f() { toggle::perform(); }
+		#endif
 
 			// static const members should be initialized by constexpr, and
 			// reinterpret_cast is not allowed in constexpr, so we use
@@ -72,6 +88,28 @@ namespace opti_init
 			}
 		};
 
+		/*
+		Interrupt-safe list policy: interrupts are disabled for the time of
+		read-modify-write sequences, and SREG is restored afterwards. Single
+		critical section covers all of them; stores and sbi/cbi, which are
+		atomic anyway, are kept out of it as far as write order allows.
+		*/
+		struct atomic_avr {
+			typedef void policy_tag;
+
+			struct guard {
+				uint8_t sreg;
+
+				guard() : sreg(SREG) { __asm__ __volatile__ ("cli" ::: "memory"); }
+				~guard() { SREG = sreg; __asm__ __volatile__ ("" ::: "memory"); }
+			};
+
+			template <typename L>
+			static void perform(const register_value_t * values) {
+				detail::perform_guarded<guard, L>::perform(values);
+			}
+		};
+
 		#define __AVR_PORT(X) \
 				template <int index> \
 				struct port##X : gpio<(pointer_int_t)(&DDR##X), (pointer_int_t)(&PORT##X), (pointer_int_t)(&PIN##X), index> {};
@@ -126,6 +164,50 @@ namespace opti_init
 
 		#undef __AVR_PORT
 
+		#ifdef PRR
+			/*
+			Peripheral is powered by clearing its power reduction bit, e.g.
+			gated<power_on<PRSPI>, spi_config...>. Bits of PRR that aren't
+			mentioned are kept; with power_off_all mentioned first in an
+			initializer, every peripheral whose gate isn't mentioned stays off,
+			and PRR is written with single store.
+			*/
+			template <int bit>
+			using power_on = modifier<(pointer_int_t)(&PRR), (1 << bit), 0, known_reset<0>>;
+
+			static constexpr uint8_t power_reduction_bits = 0
+			#ifdef PRADC
+				| (1 << PRADC)
+			#endif
+			#ifdef PRUSART0
+				| (1 << PRUSART0)
+			#endif
+			#ifdef PRUSART1
+				| (1 << PRUSART1)
+			#endif
+			#ifdef PRSPI
+				| (1 << PRSPI)
+			#endif
+			#ifdef PRUSI
+				| (1 << PRUSI)
+			#endif
+			#ifdef PRTIM0
+				| (1 << PRTIM0)
+			#endif
+			#ifdef PRTIM1
+				| (1 << PRTIM1)
+			#endif
+			#ifdef PRTIM2
+				| (1 << PRTIM2)
+			#endif
+			#ifdef PRTWI
+				| (1 << PRTWI)
+			#endif
+				;
+
+			using power_off_all = modifier<(pointer_int_t)(&PRR), power_reduction_bits, power_reduction_bits, known_reset<0>>;
+		#endif
+
 #ifdef ARDUINO
 		/* OK OK, it may look stupid to fight for bytes while using Arduino platform with its
 		 * ugly digitalRead/digitalWrite etc, but one may write efficient code even for
@@ -204,7 +286,7 @@ namespace opti_init
 		#endif
 
 		template <int number>
-		using digitalPin = typename gpio<(pointer_int_t)( digitalPinToDDRReg(number)),(pointer_int_t)( digitalPinToPortReg(number)),__digitalPinToBit(number)>;
+		using digitalPin = gpio<(pointer_int_t)( digitalPinToDDRReg(number)),(pointer_int_t)( digitalPinToPortReg(number)),(pointer_int_t)( digitalPinToPINReg(number)),__digitalPinToBit(number)>;
 
 #endif // ARDUINO
 
@@ -218,14 +300,67 @@ namespace opti_init
 
 			static_assert(my_gpio::bit_index == 0, "Bit index invalid");
 			static_assert(my_gpio::bit_mask == (1 << 0), "Bit mask invalid");
-			static_assert(my_gpio::ddr_reg_ptr() == (peripheral_register_t *)(1), "DDRx pointer invalid");
-			static_assert(my_gpio::port_reg_ptr() == (peripheral_register_t *)(2), "PORTx pointer invalid");
-			static_assert(my_gpio::pin_reg_ptr() == (peripheral_register_t *)(3), "PINx pointer invalid");
+			static_assert(my_gpio::ddr_register_bit::address == 1, "DDRx pointer invalid");
+			static_assert(my_gpio::port_register_bit::address == 2, "PORTx pointer invalid");
+			static_assert(my_gpio::pin_register_bit::address == 3, "PINx pointer invalid");
 
 			using m0 = my_gpio::set<0>;
 			using m1 = my_gpio::set<1>;
 			static_assert(is_same<m0, my_gpio::low >::value, "::set<0> isn't equal to ::low");
 			static_assert(is_same<m1, my_gpio::high >::value, "::set<1> isn't equal to ::high");
+
+			// lower I/O space registers are modified by sbi/cbi
+			using io_gpio = gpio<0x24, 0x25, 0x23, 3>;
+			using opti_init::detail::select_access;
+			using opti_init::detail::single_bit_access;
+			using opti_init::detail::store_access;
+			using opti_init::detail::rmw_access;
+
+			static_assert(select_access<0x25, io_gpio::bit_mask, io_gpio::reset_traits>::value == single_bit_access, "single bit of lower I/O register should be accessed with sbi/cbi");
+		#if OPTI_INIT_PIN_TOGGLE
+			static_assert(select_access<0x23, io_gpio::bit_mask, io_gpio::toggle::traits>::value == single_bit_access, "pin toggle should be performed with sbi");
+			static_assert(is_same<opti_init::detail::fold_distinct<list<io_gpio::toggle, io_gpio::toggle>>::type, list<>>::value, "two toggles of a pin should cancel without a store");
+			static_assert(settings<io_gpio::toggle, io_gpio::toggle, io_gpio::high>::plan::registers == 1, "cancelled toggles shouldn't be written");
+		#endif
+			static_assert(select_access<0x25, 0x18, io_gpio::reset_traits>::value == rmw_access, "several bits shouldn't be modified with sbi/cbi");
+			static_assert(select_access<0x25, 0xFF, io_gpio::reset_traits>::value == store_access, "full register should be written with single store");
+			static_assert(select_access<0x45, 0x01, io_gpio::reset_traits>::value == rmw_access, "sbi/cbi are not available in upper I/O space");
+			static_assert(select_access<0x102, 0x01, io_gpio::reset_traits>::value == rmw_access, "sbi/cbi are not available in data space");
+			static_assert(select_access<0x102, 0x01, write_one_register>::value == store_access, "write-one register shouldn't be read");
+
+			// initializer modifies the only bit which differs from reset value
+			static_assert(is_same<io_gpio::output_any::presumed, io_gpio::output_any>::value, "single changed bit should be set with sbi");
+			static_assert(io_gpio::low::presumed::is_write_only(), "register holding reset value should be written with single store");
+			using mega_gpio = gpio<0x101, 0x102, 0x100, 3>;
+			static_assert(mega_gpio::output_any::presumed::is_write_only(), "data space register should be written with single store");
+
+			// LCD data bus on PORTB[4:7] and PORTD[2:5]: one access of each port
+			using lcd_bus = pin_bus<
+				gpio<0x24, 0x25, 0x23, 4>, gpio<0x24, 0x25, 0x23, 5>, gpio<0x24, 0x25, 0x23, 6>, gpio<0x24, 0x25, 0x23, 7>,
+				gpio<0x2A, 0x2B, 0x29, 2>, gpio<0x2A, 0x2B, 0x29, 3>, gpio<0x2A, 0x2B, 0x29, 4>, gpio<0x2A, 0x2B, 0x29, 5>
+			>;
+			static_assert(opti_init::detail::length<lcd_bus::write_accesses>::value == 2, "bus should be written with one access per port");
+			static_assert(opti_init::detail::length<lcd_bus::read_accesses>::value == 2, "bus should be read with one access per port");
+
+			// whole port but two pins: single store of PORTB and DDRB
+			template <int bit>
+			using io_port = gpio<0x24, 0x25, 0x23, bit>;
+
+			using unused_pins = pin_difference<port_range<io_port, 0, 7>, pin_set<io_port<3>, io_port<5>>>;
+			static_assert(initializer<unused_pins::input_pullup>::plan::registers == 2 && initializer<unused_pins::input_pullup>::plan::reads == 0, "pin set should be written with one store per register");
+			static_assert(settings<unused_pins::input_pullup>::plan::rmws == 2, "pin set should be read-modify-written once per register");
+
+		#ifdef PRR
+			// gates of two components and power-down of the rest: single PRR store before timer registers
+			using timer_component = gated<power_on<PRTIM1>, modifier<0x81, 0x07, 0x03, known_reset<0>>>;
+			using spi_component = gated<power_on<PRSPI>, modifier<0x4C, 0x50, 0x50, known_reset<0>>>;
+			using powered = initializer<power_off_all, timer_component, spi_component>;
+
+			static_assert(powered::plan::registers == 3 && powered::plan::reads == 0, "PRR should be written once, with a store");
+			static_assert(is_same<typename opti_init::detail::head<powered::plan::modifiers>::type,
+				modifier<(pointer_int_t)(&PRR), 0xFF, power_reduction_bits & ~((1 << PRTIM1) | (1 << PRSPI)), known_reset<0>>
+			>::value, "unused peripherals should be powered off before gated registers are written");
+		#endif
 		}
 		#endif // OPTI_INIT_TEST
 
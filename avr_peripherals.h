@@ -0,0 +1,580 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_AVR_PERIPHERALS_H
+#define OPTI_INIT_AVR_PERIPHERALS_H
+
+/*
+Settings of on-chip peripherals of megaAVR parts: every setting is a
+modifier or a list of them, so a whole board bring-up is a single
+initializer, folded to one access of each register. Peripherals are
+declared only if the part has their registers.
+*/
+
+namespace opti_init
+{
+	namespace hardware
+	{
+		// clock select of timers with synchronous prescaler, e.g. timer0 and timer1
+		enum class timer_clock { stopped, div_1, div_8, div_64, div_256, div_1024, external_falling, external_rising };
+
+		// clock select of timer with asynchronous prescaler, e.g. timer2
+		enum class async_timer_clock { stopped, div_1, div_8, div_32, div_64, div_128, div_256, div_1024 };
+
+		// behavior of output compare pin on compare match
+		enum class compare_output { disconnected, toggle, clear, set };
+	}
+
+	namespace detail
+	{
+		template <typename clk_select, typename clock>
+		struct timer_clock_select;
+
+		template <typename clk_select>
+		struct timer_clock_select<clk_select, hardware::timer_clock> {
+			using clk_stopped = typename clk_select::template set<hardware::timer_clock::stopped>;
+			using clk_divider_1 = typename clk_select::template set<hardware::timer_clock::div_1>;
+			using clk_divider_8 = typename clk_select::template set<hardware::timer_clock::div_8>;
+			using clk_divider_64 = typename clk_select::template set<hardware::timer_clock::div_64>;
+			using clk_divider_256 = typename clk_select::template set<hardware::timer_clock::div_256>;
+			using clk_divider_1024 = typename clk_select::template set<hardware::timer_clock::div_1024>;
+			using clk_external_falling = typename clk_select::template set<hardware::timer_clock::external_falling>;
+			using clk_external_rising = typename clk_select::template set<hardware::timer_clock::external_rising>;
+		};
+
+		template <typename clk_select>
+		struct timer_clock_select<clk_select, hardware::async_timer_clock> {
+			using clk_stopped = typename clk_select::template set<hardware::async_timer_clock::stopped>;
+			using clk_divider_1 = typename clk_select::template set<hardware::async_timer_clock::div_1>;
+			using clk_divider_8 = typename clk_select::template set<hardware::async_timer_clock::div_8>;
+			using clk_divider_32 = typename clk_select::template set<hardware::async_timer_clock::div_32>;
+			using clk_divider_64 = typename clk_select::template set<hardware::async_timer_clock::div_64>;
+			using clk_divider_128 = typename clk_select::template set<hardware::async_timer_clock::div_128>;
+			using clk_divider_256 = typename clk_select::template set<hardware::async_timer_clock::div_256>;
+			using clk_divider_1024 = typename clk_select::template set<hardware::async_timer_clock::div_1024>;
+		};
+
+		/*
+		UBRR value of given baud rate. Double speed is used only if it's
+		closer to the rate; error beyond receiver tolerance doesn't compile.
+		*/
+		template <unsigned long cpu_frequency, unsigned long rate>
+		struct usart_baud {
+			static constexpr unsigned long normal = (cpu_frequency + 8 * rate) / (16 * rate) - 1;
+			static constexpr unsigned long doubled = (cpu_frequency + 4 * rate) / (8 * rate) - 1;
+
+			static constexpr unsigned long deviation(unsigned long divider, unsigned long ubrr) {
+				return cpu_frequency > divider * (ubrr + 1) * rate
+					? cpu_frequency - divider * (ubrr + 1) * rate
+					: divider * (ubrr + 1) * rate - cpu_frequency;
+			}
+
+			static constexpr bool double_speed = deviation(8, doubled) < deviation(16, normal);
+			static constexpr unsigned long value = double_speed ? doubled : normal;
+
+			static_assert(value < 4096, "baud rate is too low for CPU frequency");
+			static_assert(100 * deviation(double_speed ? 8 : 16, value) <= 3 * cpu_frequency, "baud rate error exceeds 3%");
+		};
+
+		/*
+		TWBR value and prescaler of given SCL frequency, which is
+		cpu_frequency / (16 + 2 * TWBR * 4^prescaler). Divider is rounded up,
+		so SCL never exceeds given frequency, e.g. 400 kHz of fast mode.
+		*/
+		template <unsigned long cpu_frequency, unsigned long scl_frequency>
+		struct twi_bit_rate {
+			static_assert(cpu_frequency >= 16 * scl_frequency, "SCL frequency is too high for CPU frequency");
+
+			static constexpr unsigned long divider = (cpu_frequency - 16 * scl_frequency + 2 * scl_frequency - 1) / (2 * scl_frequency);
+			static constexpr int prescaler = divider <= 255 ? 0 : divider <= 4 * 255 ? 1 : divider <= 16 * 255 ? 2 : 3;
+			static constexpr unsigned long value = (divider + (1UL << (2 * prescaler)) - 1) >> (2 * prescaler);
+
+			static_assert(value < 256, "SCL frequency is too low for CPU frequency");
+		};
+	}
+
+	namespace hardware
+	{
+		/*
+		8-bit timer/counter, e.g. timer0 and timer2. Control and compare
+		registers are cleared on reset. Interrupt enable bits are the same in
+		TIMSK and TIFR, and their positions are given by the part.
+		*/
+		template <pointer_int_t ptr_tccra, pointer_int_t ptr_tccrb, pointer_int_t ptr_ocra, pointer_int_t ptr_ocrb,
+			pointer_int_t ptr_timsk, pointer_int_t ptr_tifr, int toie, int ociea, int ocieb, typename clock_>
+		struct timer8 : detail::timer_clock_select<typename peripheral_register<ptr_tccrb, 0x00>::template field<0, 3, clock_>, clock_> {
+			using tccra = peripheral_register<ptr_tccra, 0x00>;
+			using tccrb = peripheral_register<ptr_tccrb, 0x00>;
+			using ocra = peripheral_register<ptr_ocra, 0x00>;
+			using ocrb = peripheral_register<ptr_ocrb, 0x00>;
+			using timsk = peripheral_register<ptr_timsk, 0x00>;
+			using tifr = flag_register<ptr_tifr>;
+
+			using clock = clock_;
+			using clk_select = typename tccrb::template field<0, 3, clock>;
+
+			// waveform generation mode, WGMx2 is in TCCRxB
+			template <int wgm>
+			using mode = list<
+				typename tccra::template field<0, 2>::template set<(wgm & 3)>,
+				typename tccrb::template bit<3>::template set<(wgm >> 2)>
+			>;
+
+			using mode_normal = mode<0>;
+			using mode_pwm_phase_correct_max = mode<1>;
+			using mode_ctc = mode<2>;
+			using mode_fast_pwm_max = mode<3>;
+			using mode_pwm_phase_correct_ocra = mode<5>;
+			using mode_fast_pwm_ocra = mode<7>;
+
+			template <compare_output output>
+			using output_a = typename tccra::template field<6, 2, compare_output>::template set<output>;
+
+			template <compare_output output>
+			using output_b = typename tccra::template field<4, 2, compare_output>::template set<output>;
+
+			template <register_value_t value>
+			using compare_a = typename ocra::template field<0, 8>::template set<value>;
+
+			template <register_value_t value>
+			using compare_b = typename ocrb::template field<0, 8>::template set<value>;
+
+			using overflow_interrupt = typename timsk::template bit<toie>::high;
+			using compare_a_interrupt = typename timsk::template bit<ociea>::high;
+			using compare_b_interrupt = typename timsk::template bit<ocieb>::high;
+
+			// pending flags are cleared by writing one
+			using clear_flags = modifier<ptr_tifr, (1 << toie) | (1 << ociea) | (1 << ocieb), (1 << toie) | (1 << ociea) | (1 << ocieb), typename tifr::traits>;
+		};
+
+		/*
+		16-bit timer/counter with input capture, e.g. timer1. Waveform
+		generation mode is dispersed across both control registers; compare
+		and capture registers are accessed as 16-bit pairs.
+		*/
+		template <pointer_int_t ptr_tccra, pointer_int_t ptr_tccrb, pointer_int_t ptr_ocra, pointer_int_t ptr_ocrb, pointer_int_t ptr_icr,
+			pointer_int_t ptr_timsk, pointer_int_t ptr_tifr, int toie, int ociea, int ocieb, int icie>
+		struct timer16 : detail::timer_clock_select<typename peripheral_register<ptr_tccrb, 0x00>::template field<0, 3, timer_clock>, timer_clock> {
+			using tccra = peripheral_register<ptr_tccra, 0x00>;
+			using tccrb = peripheral_register<ptr_tccrb, 0x00>;
+			using ocra = sized_register<uint16_t, ptr_ocra, 0x0000>;
+			using ocrb = sized_register<uint16_t, ptr_ocrb, 0x0000>;
+			using icr = sized_register<uint16_t, ptr_icr, 0x0000>;
+			using timsk = peripheral_register<ptr_timsk, 0x00>;
+			using tifr = flag_register<ptr_tifr>;
+
+			using clock = timer_clock;
+			using clk_select = typename tccrb::template field<0, 3, clock>;
+
+			template <int wgm>
+			using mode = list<
+				typename tccra::template field<0, 2>::template set<(wgm & 3)>,
+				typename tccrb::template field<3, 2>::template set<(wgm >> 2)>
+			>;
+
+			using mode_normal = mode<0>;
+			using mode_pwm_phase_correct_8bit = mode<1>;
+			using mode_pwm_phase_correct_9bit = mode<2>;
+			using mode_pwm_phase_correct_10bit = mode<3>;
+			using mode_ctc = mode<4>;
+			using mode_fast_pwm_8bit = mode<5>;
+			using mode_fast_pwm_9bit = mode<6>;
+			using mode_fast_pwm_10bit = mode<7>;
+			using mode_pwm_phase_frequency_correct_icr = mode<8>;
+			using mode_pwm_phase_frequency_correct_ocra = mode<9>;
+			using mode_pwm_phase_correct_icr = mode<10>;
+			using mode_pwm_phase_correct_ocra = mode<11>;
+			using mode_ctc_icr = mode<12>;
+			using mode_fast_pwm_icr = mode<14>;
+			using mode_fast_pwm_ocra = mode<15>;
+
+			template <compare_output output>
+			using output_a = typename tccra::template field<6, 2, compare_output>::template set<output>;
+
+			template <compare_output output>
+			using output_b = typename tccra::template field<4, 2, compare_output>::template set<output>;
+
+			template <register_value_t value>
+			using compare_a = typename ocra::template field<0, 16>::template set<value>;
+
+			template <register_value_t value>
+			using compare_b = typename ocrb::template field<0, 16>::template set<value>;
+
+			// TOP of *_icr modes
+			template <register_value_t value>
+			using top = typename icr::template field<0, 16>::template set<value>;
+
+			using capture_noise_canceler = typename tccrb::template bit<7>::high;
+			using capture_rising_edge = typename tccrb::template bit<6>::high;
+			using capture_falling_edge = typename tccrb::template bit<6>::low;
+
+			using overflow_interrupt = typename timsk::template bit<toie>::high;
+			using compare_a_interrupt = typename timsk::template bit<ociea>::high;
+			using compare_b_interrupt = typename timsk::template bit<ocieb>::high;
+			using capture_interrupt = typename timsk::template bit<icie>::high;
+
+			using clear_flags = modifier<ptr_tifr, (1 << toie) | (1 << ociea) | (1 << ocieb) | (1 << icie), (1 << toie) | (1 << ociea) | (1 << ocieb) | (1 << icie), typename tifr::traits>;
+		};
+
+		/*
+		USART in asynchronous mode, e.g. usart0. Bit positions are the same
+		in every USART of megaAVR parts. UCSRnA has UDREn set on reset, and
+		UCSRnC selects 8N1 frames. TXCn of UCSRnA is cleared by writing one,
+		and its error flags should be written as zero, so read-modify-write
+		writes them all as zero.
+		*/
+		template <pointer_int_t ptr_ucsra, pointer_int_t ptr_ucsrb, pointer_int_t ptr_ucsrc, pointer_int_t ptr_ubrr, pointer_int_t ptr_udr>
+		struct usart {
+			using ucsra = basic_register<ptr_ucsra, register_traits<0xFF, 0x20, access::read_write_flags<0x5C>, uint8_t>>;    // TXC, FE, DOR, UPE
+			using ucsrb = peripheral_register<ptr_ucsrb, 0x00>;
+			using ucsrc = peripheral_register<ptr_ucsrc, 0x06>;
+			using ubrr = sized_register<uint16_t, ptr_ubrr, 0x0000>;
+			using udr = peripheral_register<ptr_udr>;
+
+			enum class parity { none = 0, even = 2, odd = 3 };
+
+			// UBRRn and U2Xn computed at compile time, e.g. baud<F_CPU, 115200>
+			template <unsigned long cpu_frequency, unsigned long rate>
+			using baud = list<
+				typename ubrr::template field<0, 12>::template set<detail::usart_baud<cpu_frequency, rate>::value>,
+				typename ucsra::template bit<1>::template set<detail::usart_baud<cpu_frequency, rate>::double_speed>
+			>;
+
+			template <int data_bits, parity parity_mode, int stop_bits>
+			struct frame_format {
+				static_assert(data_bits >= 5 && data_bits <= 9, "USART frame has 5 to 9 data bits");
+				static_assert(stop_bits == 1 || stop_bits == 2, "USART frame has 1 or 2 stop bits");
+
+				// UCSZn2 of 9-bit frames is in UCSRnB
+				typedef list<
+					typename ucsrc::template field<1, 2>::template set<(data_bits == 9 ? 3 : data_bits - 5)>,
+					typename ucsrb::template bit<2>::template set<(data_bits == 9)>,
+					typename ucsrc::template field<4, 2, parity>::template set<parity_mode>,
+					typename ucsrc::template bit<3>::template set<(stop_bits == 2)>
+				> type;
+			};
+
+			// e.g. frame<8, parity::even>
+			template <int data_bits, parity parity_mode = parity::none, int stop_bits = 1>
+			using frame = typename frame_format<data_bits, parity_mode, stop_bits>::type;
+
+			using receiver_on = typename ucsrb::template bit<4>::high;
+			using transmitter_on = typename ucsrb::template bit<3>::high;
+
+			using receive_interrupt = typename ucsrb::template bit<7>::high;
+			using transmit_interrupt = typename ucsrb::template bit<6>::high;
+			using data_empty_interrupt = typename ucsrb::template bit<5>::high;
+
+			// conditions of wait_until
+			using receive_complete = typename ucsra::template bit<7>::high;
+			using transmit_complete = typename ucsra::template bit<6>::high;
+			using data_empty = typename ucsra::template bit<5>::high;
+		};
+
+		#if defined(TCCR0A) && defined(TCCR0B) && defined(OCR0A) && defined(OCR0B)
+			#ifdef TIMSK0
+				using timer0 = timer8<(pointer_int_t)(&TCCR0A), (pointer_int_t)(&TCCR0B), (pointer_int_t)(&OCR0A), (pointer_int_t)(&OCR0B),
+					(pointer_int_t)(&TIMSK0), (pointer_int_t)(&TIFR0), TOIE0, OCIE0A, OCIE0B, timer_clock>;
+			#elif defined(TIMSK)
+				// timer interrupts share TIMSK, e.g. on attiny
+				using timer0 = timer8<(pointer_int_t)(&TCCR0A), (pointer_int_t)(&TCCR0B), (pointer_int_t)(&OCR0A), (pointer_int_t)(&OCR0B),
+					(pointer_int_t)(&TIMSK), (pointer_int_t)(&TIFR), TOIE0, OCIE0A, OCIE0B, timer_clock>;
+			#endif
+		#endif
+
+		#if defined(TCCR2A) && defined(TCCR2B) && defined(TIMSK2)
+			using timer2 = timer8<(pointer_int_t)(&TCCR2A), (pointer_int_t)(&TCCR2B), (pointer_int_t)(&OCR2A), (pointer_int_t)(&OCR2B),
+				(pointer_int_t)(&TIMSK2), (pointer_int_t)(&TIFR2), TOIE2, OCIE2A, OCIE2B, async_timer_clock>;
+		#endif
+
+		#define __AVR_TIMER16(N) \
+				using timer##N = timer16<(pointer_int_t)(&TCCR##N##A), (pointer_int_t)(&TCCR##N##B), (pointer_int_t)(&OCR##N##A), (pointer_int_t)(&OCR##N##B), (pointer_int_t)(&ICR##N), \
+					(pointer_int_t)(&TIMSK##N), (pointer_int_t)(&TIFR##N), TOIE##N, OCIE##N##A, OCIE##N##B, ICIE##N>;
+
+		#if defined(TCCR1A) && defined(ICR1) && defined(TIMSK1)
+			__AVR_TIMER16(1)
+		#endif
+
+		#if defined(TCCR3A) && defined(ICR3) && defined(TIMSK3)
+			__AVR_TIMER16(3)
+		#endif
+
+		#if defined(TCCR4A) && defined(ICR4) && defined(TIMSK4)
+			__AVR_TIMER16(4)
+		#endif
+
+		#if defined(TCCR5A) && defined(ICR5) && defined(TIMSK5)
+			__AVR_TIMER16(5)
+		#endif
+
+		#undef __AVR_TIMER16
+
+		#define __AVR_USART(N) \
+				using usart##N = usart<(pointer_int_t)(&UCSR##N##A), (pointer_int_t)(&UCSR##N##B), (pointer_int_t)(&UCSR##N##C), (pointer_int_t)(&UBRR##N), (pointer_int_t)(&UDR##N)>;
+
+		#if defined(UCSR0A) && defined(UBRR0)
+			__AVR_USART(0)
+		#endif
+
+		#if defined(UCSR1A) && defined(UBRR1)
+			__AVR_USART(1)
+		#endif
+
+		#if defined(UCSR2A) && defined(UBRR2)
+			__AVR_USART(2)
+		#endif
+
+		#if defined(UCSR3A) && defined(UBRR3)
+			__AVR_USART(3)
+		#endif
+
+		#undef __AVR_USART
+
+		#if defined(ADMUX) && defined(ADCSRA) && defined(REFS0) && !defined(REFS2)
+			/*
+			Analog to digital converter. Enabling it, reference and channel
+			selection and prescaler are folded to one write of ADMUX and one of
+			ADCSRA. ADIF is cleared by writing one, so read-modify-write of
+			ADCSRA writes it as zero, keeping pending conversion result flag.
+			*/
+			struct adc {
+				using admux = peripheral_register<(pointer_int_t)(&ADMUX), 0x00>;
+				using adcsra = basic_register<(pointer_int_t)(&ADCSRA), register_traits<0xFF, 0x00, access::read_write_flags<(1 << ADIF)>, uint8_t>>;
+				using data = read_only_register<(pointer_int_t)(&ADC), uint16_t>;
+
+				// internal reference is 1.1V on most parts, 2.56V on some larger ones
+				enum class reference { external, avcc, internal = 3 };
+				enum class prescaler { div_2 = 1, div_4, div_8, div_16, div_32, div_64, div_128 };
+
+				template <reference value>
+				using reference_select = admux::field<REFS0, 2, reference>::set<value>;
+
+				using reference_external = reference_select<reference::external>;
+				using reference_avcc = reference_select<reference::avcc>;
+				using reference_internal = reference_select<reference::internal>;
+
+			#ifdef MUX4
+				using channel_select = admux::field<MUX0, 5>;
+			#else
+				using channel_select = admux::field<MUX0, 4>;
+			#endif
+
+				template <int index>
+				using channel = channel_select::set<index>;
+
+				using clk_select = adcsra::field<ADPS0, 3, prescaler>;
+
+				template <prescaler value>
+				using clk_divider = clk_select::set<value>;
+
+				using enable = adcsra::bit<ADEN>::high;
+				using disable = adcsra::bit<ADEN>::low;
+				using interrupt = adcsra::bit<ADIE>::high;
+				using left_adjust = admux::bit<ADLAR>::high;
+
+				// ADSC is folded into the same ADCSRA write as other settings wherever it's
+				// mentioned, so start a conversion with separate settings<start_conversion> after configuration
+				using start_conversion = adcsra::bit<ADSC>::high;
+
+				// condition of wait_until
+				using conversion_done = adcsra::bit<ADSC>::low;
+
+			#if defined(ADCSRB) && defined(ADTS0)
+				using adcsrb = peripheral_register<(pointer_int_t)(&ADCSRB), 0x00>;
+
+				enum class trigger { free_running, analog_comparator, external_interrupt_0, timer0_compare_a, timer0_overflow, timer1_compare_b, timer1_overflow, timer1_capture };
+
+				template <trigger source>
+				using auto_trigger = list< adcsra::bit<ADATE>::high, adcsrb::field<ADTS0, 3, trigger>::set<source> >;
+			#endif
+
+			#ifdef DIDR0
+				using didr0 = peripheral_register<(pointer_int_t)(&DIDR0), 0x00>;
+
+				// digital input buffer of analog pin is turned off to save power
+				template <int index>
+				using digital_input_off = typename didr0::template bit<index>::high;
+			#endif
+			};
+		#endif
+
+		#if defined(SPCR) && defined(SPSR) && defined(SPDR)
+			/*
+			SPI controller. Clock divider is set by both SPR bits of SPCR and
+			SPI2X of SPSR; status bits of SPSR are read-only, so it's written
+			with single store.
+			*/
+			struct spi {
+				using spcr = peripheral_register<(pointer_int_t)(&SPCR), 0x00>;
+				using spsr = peripheral_register<(pointer_int_t)(&SPSR), 0x00>;
+				using spdr = peripheral_register<(pointer_int_t)(&SPDR)>;
+
+				// SPR1:0 values, then the same ones with SPI2X
+				enum class clock { div_4, div_16, div_64, div_128, div_2, div_8, div_32 };
+
+				template <clock value>
+				using clk_divider = list<
+					spcr::field<SPR0, 2>::set<(register_value_t(value) & 3)>,
+					spsr::bit<SPI2X>::set<(register_value_t(value) >> 2)>
+				>;
+
+				using enable = spcr::bit<SPE>::high;
+				using disable = spcr::bit<SPE>::low;
+				using master = spcr::bit<MSTR>::high;
+				using slave = spcr::bit<MSTR>::low;
+				using msb_first = spcr::bit<DORD>::low;
+				using lsb_first = spcr::bit<DORD>::high;
+				using interrupt = spcr::bit<SPIE>::high;
+
+				// SPI mode 0 to 3 is CPOL and CPHA bits
+				template <int mode>
+				using data_mode = spcr::field<CPHA, 2>::set<mode>;
+
+				// condition of wait_until
+				using transfer_complete = spsr::bit<SPIF>::high;
+			};
+		#endif
+
+		#if defined(TWBR) && defined(TWCR) && defined(TWSR) && defined(TWAR)
+			/*
+			Two-wire interface. Status bits of TWSR are read-only, and TWINT of
+			TWCR is cleared by writing one, which starts next bus operation, so
+			read-modify-write of TWCR writes it as zero. Both are written with
+			single store from their reset values by initializer.
+			*/
+			struct twi {
+				using twbr = peripheral_register<(pointer_int_t)(&TWBR), 0x00>;
+				using twsr = peripheral_register<(pointer_int_t)(&TWSR), 0xF8>;
+				using twcr = basic_register<(pointer_int_t)(&TWCR), register_traits<0xFF, 0x00, access::read_write_flags<(1 << TWINT)>, uint8_t>>;
+				using twar = peripheral_register<(pointer_int_t)(&TWAR), 0xFE>;
+
+				// TWBR and prescaler computed at compile time, e.g. bit_rate<F_CPU, 400000>
+				template <unsigned long cpu_frequency, unsigned long scl_frequency>
+				using bit_rate = list<
+					twbr::field<0, 8>::set<detail::twi_bit_rate<cpu_frequency, scl_frequency>::value>,
+					twsr::field<TWPS0, 2>::set<detail::twi_bit_rate<cpu_frequency, scl_frequency>::prescaler>
+				>;
+
+				using enable = twcr::bit<TWEN>::high;
+				using interrupt = twcr::bit<TWIE>::high;
+				using acknowledge = twcr::bit<TWEA>::high;
+
+				// slave address, and whether general call is answered
+				template <uint8_t address, bool general_call = false>
+				using own_address = list< twar::field<1, 7>::set<address>, twar::bit<TWGCE>::set<general_call> >;
+
+				// condition of wait_until
+				using ready = twcr::bit<TWINT>::high;
+			};
+		#endif
+
+		#if defined(WDTCSR) && defined(WDCE) && defined(WDP3)
+			/*
+			Watchdog timer. Its interrupt is enabled as any other setting, while
+			reset mode and timeout are changed by timed sequence, which can't be
+			folded with other writes: start<timeout::s1>() and stop() do it with
+			interrupts disabled.
+			*/
+			struct watchdog {
+				using wdtcsr = peripheral_register<(pointer_int_t)(&WDTCSR)>;
+
+				enum class timeout { ms16, ms32, ms64, ms125, ms250, ms500, s1, s2, s4, s8 };
+
+				using interrupt = wdtcsr::bit<WDIE>::high;
+
+				template <timeout value, bool reset = true, bool interrupt = false>
+				static void start() {
+					change<((uint8_t(value) & 7) << WDP0) | ((uint8_t(value) >> 3) << WDP3) | (reset ? (1 << WDE) : 0) | (interrupt ? (1 << WDIE) : 0)>();
+				}
+
+				static void stop() {
+				#ifdef MCUSR
+					// WDE is forced while reset flag is set
+					modifier<(pointer_int_t)(&MCUSR), (1 << WDRF), 0>::perform();
+				#endif
+					change<0>();
+				}
+
+			private:
+				// new value should be written within 4 cycles after WDCE, so both stores are
+				// a single asm statement, as wdt_enable() of avr-libc does, whatever optimization is
+				template <register_value_t value>
+				static void change() {
+					atomic_avr::guard guard;
+					__asm__ __volatile__ (
+						"wdr" "\n\t"
+						"sts %0, %1" "\n\t"
+						"sts %0, %2"
+						:
+						: "n" (wdtcsr::address), "r" (uint8_t((1 << WDCE) | (1 << WDE))), "r" (uint8_t(value))
+						: "memory"
+					);
+				}
+			};
+		#endif
+
+		#ifdef OPTI_INIT_TESTS
+		namespace test
+		{
+			using namespace opti_init::test::utils;
+
+			// 16 MHz: 9600 baud is exact enough without double speed, 115200 isn't
+			static_assert(detail::usart_baud<16000000, 9600>::value == 103 && !detail::usart_baud<16000000, 9600>::double_speed, "UBRR of 9600 baud invalid");
+			static_assert(detail::usart_baud<16000000, 115200>::value == 16 && detail::usart_baud<16000000, 115200>::double_speed, "UBRR of 115200 baud invalid");
+			static_assert(detail::twi_bit_rate<16000000, 100000>::value == 72 && detail::twi_bit_rate<16000000, 100000>::prescaler == 0, "TWBR of 100 kHz invalid");
+			static_assert(detail::twi_bit_rate<16000000, 1000>::value == 125 && detail::twi_bit_rate<16000000, 1000>::prescaler == 3, "TWI prescaler invalid");
+			// 14.7456 MHz: TWBR 10 would give 409.6 kHz, 11 gives 368.6 kHz
+			static_assert(detail::twi_bit_rate<14745600, 400000>::value == 11 && detail::twi_bit_rate<14745600, 400000>::prescaler == 0, "TWBR should be rounded up");
+
+			// registers of timer and USART at arbitrary addresses
+			using test_timer = timer16<0x80, 0x81, 0x88, 0x8A, 0x86, 0x6F, 0x36, 0, 1, 2, 5>;
+			using test_usart = usart<0xC0, 0xC1, 0xC2, 0xC4, 0xC6>;
+
+			static_assert(is_same<typename test_timer::mode_fast_pwm_icr,
+				list<modifier<0x80, 0x03, 0x02, known_reset<0>>, modifier<0x81, 0x18, 0x18, known_reset<0>>>>::value, "WGM bits should be split between control registers");
+			static_assert(is_same<typename test_usart::frame<9, test_usart::parity::odd, 2>,
+				list<modifier<0xC2, 0x06, 0x06, known_reset<0x06>>, modifier<0xC1, 0x04, 0x04, known_reset<0>>, modifier<0xC2, 0x30, 0x30, known_reset<0x06>>, modifier<0xC2, 0x08, 0x08, known_reset<0x06>>>>::value, "9-bit frame invalid");
+
+			// timer, serial port and its frame: one store of each register, nothing is read
+			using bring_up = initializer<
+				test_timer::mode_fast_pwm_icr, test_timer::top<39999>, test_timer::compare_a<3000>, test_timer::output_a<compare_output::clear>, test_timer::clk_divider_8,
+				test_usart::baud<16000000, 115200>, test_usart::frame<8>, test_usart::receiver_on, test_usart::transmitter_on, test_usart::receive_interrupt
+			>;
+			static_assert(bring_up::plan::reads == 0, "registers of known reset value shouldn't be read");
+			static_assert(bring_up::plan::registers == 8, "every register should be written once");
+			static_assert(opti_init::detail::flag_bits<typename test_usart::ucsra::traits::access_policy>::value == 0x5C, "UCSRnA flags should be written as zero");
+
+		#if defined(TCCR0A) && defined(ADMUX) && defined(UCSR0A)
+			using board = initializer<
+				timer0::mode_fast_pwm_max, timer0::output_a<compare_output::clear>, timer0::clk_divider_64, timer0::overflow_interrupt,
+				adc::reference_avcc, adc::channel<3>, adc::clk_divider<adc::prescaler::div_128>, adc::enable, adc::interrupt,
+				usart0::baud<16000000, 9600>, usart0::receiver_on, usart0::transmitter_on
+			>;
+			static_assert(board::plan::reads == 0 && board::plan::registers == 8, "bring-up should be folded to one store of each register");
+			static_assert(opti_init::detail::flag_bits<typename adc::adcsra::traits::access_policy>::value == (1 << ADIF), "ADIF should be written as zero");
+		#endif
+		}
+		#endif // OPTI_INIT_TESTS
+	}
+}
+
+#endif
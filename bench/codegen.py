@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Generated code benchmark for opti_init.
+
+Every configuration in bench/codegen is written twice: as an opti_init
+initializer (name.cpp) and as hand-optimized C (name.c), both defining
+config(). Both are compiled for every available target, and code of config()
+is compared: instruction count, size in bytes, and register loads and stores.
+Configuration code is straight-line, so static load/store counts are the
+executed ones as well. On host, initializer is also run against simulated
+registers (OPTI_INIT_SIMULATED), and traced accesses are reported.
+
+Host compiler is always used, avr-gcc is used if it's installed. Exit status
+is non-zero if initializer code is worse than hand-written one in any metric.
+
+    bench/codegen.py
+    bench/codegen.py -o codegen.txt --only timer
+"""
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+CORPUS = os.path.join(ROOT, "bench", "codegen")
+
+DRIVER = r'''
+#define OPTI_INIT_SIMULATED
+#include "opti_init.h"
+#include <stdio.h>
+
+extern "C" void config(void);
+
+int main() {
+	using namespace opti_init::simulated;
+	config();
+	printf("%u %u\n", registers().count(read_access), registers().count(write_access));
+	return 0;
+}
+'''
+
+
+class Target:
+	def __init__(self, name, cc, cxx, objdump, nm, flags, classify, simulate):
+		self.name = name
+		self.cc = cc
+		self.cxx = cxx
+		self.objdump = objdump
+		self.nm = nm
+		self.flags = flags
+		self.classify = classify
+		self.simulate = simulate
+
+
+def split_operands(text):
+	operands, depth, current = [], 0, ""
+	for char in text:
+		if char == "," and depth == 0:
+			operands.append(current.strip())
+			current = ""
+			continue
+		depth += char == "("
+		depth -= char == ")"
+		current += char
+	if current.strip():
+		operands.append(current.strip())
+	return operands
+
+
+def classify_x86(mnemonic, operands):
+	"""(loads, stores) of AT&T syntax instruction"""
+	memory = [not op.startswith(("$", "%")) for op in operands]
+	if not operands or mnemonic.startswith(("j", "call", "lea", "nop", "push", "pop")):
+		return 0, 0
+	if mnemonic.startswith("mov"):
+		return int(memory[0] and len(operands) > 1), int(memory[-1])
+	if mnemonic.startswith(("cmp", "test", "bt")):
+		return int(any(memory)), 0
+	# read-modify-write of destination
+	return int(any(memory)), int(memory[-1])
+
+
+def classify_avr(mnemonic, operands):
+	if mnemonic in ("sbi", "cbi"):
+		return 1, 1
+	if mnemonic in ("in", "lds") or mnemonic.startswith("ld"):
+		return 1, 0
+	if mnemonic in ("out", "sts") or mnemonic.startswith("st"):
+		return 0, 1
+	return 0, 0
+
+
+def run(cmd):
+	result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+	if result.returncode != 0:
+		raise RuntimeError("%s\n%s" % (" ".join(cmd), result.stderr))
+	return result.stdout
+
+
+def analyze(target, obj):
+	size = 0
+	for line in run([target.nm, "-S", "--defined-only", obj]).splitlines():
+		parts = line.split()
+		if len(parts) == 4 and parts[3] == "config":
+			size = int(parts[1], 16)
+
+	instructions = loads = stores = 0
+	inside = False
+	for line in run([target.objdump, "-d", "--no-show-raw-insn", obj]).splitlines():
+		if line.endswith("<config>:"):
+			inside = True
+			continue
+		if not inside:
+			continue
+		if not line.strip():
+			break
+		match = re.match(r"\s*[0-9a-f]+:\s+(\S+)\s*([^;#<]*)", line)
+		if not match:
+			continue
+		instructions += 1
+		load, store = target.classify(match.group(1), split_operands(match.group(2)))
+		loads += load
+		stores += store
+	return [instructions, size, loads, stores]
+
+
+def compile_variant(target, source, tmp, extra=()):
+	obj = os.path.join(tmp, os.path.basename(source) + ".o")
+	if source.endswith(".cpp"):
+		cmd = [target.cxx, "-std=c++11"]
+	else:
+		cmd = [target.cc]
+	run(cmd + target.flags + list(extra) + ["-I" + ROOT, "-I" + CORPUS, "-c", source, "-o", obj])
+	return obj
+
+
+def simulate(target, source, tmp):
+	driver = os.path.join(tmp, "driver.cpp")
+	with open(driver, "w") as f:
+		f.write(DRIVER)
+	obj = compile_variant(target, source, tmp, ["-DOPTI_INIT_SIMULATED"])
+	binary = os.path.join(tmp, "simulated")
+	run([target.cxx, "-std=c++11", "-I" + ROOT, driver, obj, "-o", binary])
+	reads, writes = run([binary]).split()
+	return int(reads), int(writes)
+
+
+def targets(args):
+	result = [Target("host", args.cc, args.cxx, "objdump", "nm", ["-O2"], classify_x86, True)]
+	if shutil.which("avr-g++") and shutil.which("avr-gcc"):
+		result.append(Target("avr", "avr-gcc", "avr-g++", "avr-objdump", "avr-nm",
+			["-Os", "-mmcu=" + args.mcu], classify_avr, False))
+	else:
+		print("avr-gcc isn't installed, AVR target skipped")
+	return result
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("--cxx", default=os.environ.get("CXX", "g++"))
+	parser.add_argument("--cc", default=os.environ.get("CC", "gcc"))
+	parser.add_argument("--mcu", default="atmega328p", help="AVR target MCU")
+	parser.add_argument("--only", nargs="+", help="configurations to measure, default: all")
+	parser.add_argument("-o", "--output", help="save results to file")
+	args = parser.parse_args()
+
+	names = sorted(os.path.basename(path)[:-4] for path in glob.glob(os.path.join(CORPUS, "*.cpp")))
+	if args.only:
+		names = [name for name in names if name in args.only]
+
+	lines = ["target config variant instructions bytes loads stores traced_reads traced_writes"]
+	print(lines[0])
+	failed = False
+	for target in targets(args):
+		for name in names:
+			with tempfile.TemporaryDirectory() as tmp:
+				opti_source = os.path.join(CORPUS, name + ".cpp")
+				hand_source = os.path.join(CORPUS, name + ".c")
+				opti = analyze(target, compile_variant(target, opti_source, tmp))
+				hand = analyze(target, compile_variant(target, hand_source, tmp))
+				traced = simulate(target, opti_source, tmp) if target.simulate else ("-", "-")
+
+			for variant, metrics, trace in (("initializer", opti, traced), ("hand", hand, ("-", "-"))):
+				lines.append(" ".join(str(x) for x in [target.name, name, variant] + metrics + list(trace)))
+				print(lines[-1])
+			worse = [metric for metric, a, b in zip(("instructions", "bytes", "loads", "stores"), opti, hand) if a > b]
+			if worse:
+				print("worse than hand-written: %s %s: %s" % (target.name, name, ", ".join(worse)))
+				failed = True
+			sys.stdout.flush()
+
+	if args.output:
+		with open(args.output, "w") as f:
+			f.write("\n".join(lines) + "\n")
+	return 1 if failed else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
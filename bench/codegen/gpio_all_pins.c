@@ -0,0 +1,8 @@
+#include "registers.h"
+
+void config(void) {
+	REG8(BENCH_DDRB) = (1 << 6) | (1 << 4) | (1 << 3);
+	REG8(BENCH_PORTB) = (1 << 5) | (1 << 3);
+	REG8(BENCH_DDRD) = (1 << 7) | (1 << 5) | (1 << 4) | (1 << 3) | (1 << 1);
+	REG8(BENCH_PORTD) = (1 << 6) | (1 << 5) | (1 << 4) | (1 << 1) | (1 << 0);
+}
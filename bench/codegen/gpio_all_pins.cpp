@@ -0,0 +1,24 @@
+#include "registers.h"
+using namespace bench;
+
+// every pin of two ports, as in README
+extern "C" void config(void) {
+	initializer<
+		portB<0>::input_floating,
+		portB<1>::input_floating,
+		portB<2>::input_floating,
+		portB<3>::output_high,
+		portB<4>::output_low,
+		portB<5>::input_pullup,
+		portB<6>::output_low,
+		portB<7>::input_floating,
+		portD<0>::input_pullup,
+		portD<1>::output_high,
+		portD<2>::input_floating,
+		portD<3>::output_low,
+		portD<4>::output_high,
+		portD<5>::output_high,
+		portD<6>::input_pullup,
+		portD<7>::output_low
+	>{};
+}
@@ -0,0 +1,66 @@
+/* Register map shared by both variants of every benchmark configuration:
+ * data space addresses of ATmega328P, so that AVR build accesses real
+ * registers, and host build accesses the same addresses as 8/16-bit
+ * locations.
+ */
+#ifndef BENCH_REGISTERS_H
+#define BENCH_REGISTERS_H
+
+#include <stdint.h>
+
+#define BENCH_PINB   0x23
+#define BENCH_DDRB   0x24
+#define BENCH_PORTB  0x25
+#define BENCH_PIND   0x29
+#define BENCH_DDRD   0x2A
+#define BENCH_PORTD  0x2B
+#define BENCH_TIMSK1 0x6F
+#define BENCH_TCCR1A 0x80
+#define BENCH_TCCR1B 0x81
+#define BENCH_OCR1A  0x88
+
+#define REG8(address)  (*(volatile uint8_t *)(address))
+#define REG16(address) (*(volatile uint16_t *)(address))
+
+#ifdef __cplusplus
+#include "opti_init.h"
+
+namespace bench
+{
+	using namespace opti_init;
+
+	// same as hardware::gpio of avr.h, but with 8-bit registers on any target
+	template<pointer_int_t ddr, pointer_int_t port, int bit>
+	struct gpio {
+		using ddr_register = hardware::sized_register<uint8_t, ddr, 0>;
+		using port_register = hardware::sized_register<uint8_t, port, 0>;
+
+		using input_any = typename ddr_register::template set<bit, false>;
+		using output_any = typename ddr_register::template set<bit, true>;
+		using low = typename port_register::template set<bit, false>;
+		using high = typename port_register::template set<bit, true>;
+
+		using output_low = list< low, output_any >;
+		using output_high = list< high, output_any >;
+		using input_floating = list< low, input_any >;
+		using input_pullup = list< high, input_any >;
+	};
+
+	template<int bit>
+	using portB = gpio<BENCH_DDRB, BENCH_PORTB, bit>;
+
+	template<int bit>
+	using portD = gpio<BENCH_DDRD, BENCH_PORTD, bit>;
+
+	// Arduino Uno numbering: pins 0..7 are port D, 8..13 are port B
+	template<int pin>
+	using digitalPin = typename opti_init::detail::conditional<(pin < 8), portD<pin % 8>, portB<pin % 8>>::type;
+
+	using tccr1a = hardware::sized_register<uint8_t, BENCH_TCCR1A, 0>;
+	using tccr1b = hardware::sized_register<uint8_t, BENCH_TCCR1B, 0>;
+	using timsk1 = hardware::sized_register<uint8_t, BENCH_TIMSK1, 0>;
+	using ocr1a = hardware::sized_register<uint16_t, BENCH_OCR1A, 0>;
+}
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#include "registers.h"
+
+void config(void) {
+	REG8(BENCH_DDRD) = (REG8(BENCH_DDRD) & ~(1 << 2)) | (1 << 4) | (1 << 3);
+	REG8(BENCH_PORTD) = (REG8(BENCH_PORTD) & ~(1 << 2)) | (1 << 4) | (1 << 3);
+}
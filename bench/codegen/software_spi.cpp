@@ -0,0 +1,16 @@
+#include "registers.h"
+using namespace bench;
+
+// softwareSPI example of README, performed as standalone list
+template <int MISO, int MOSI, int CLK>
+struct softwareSPI {
+	using init = list<
+		typename digitalPin<MISO>::input_floating,
+		typename digitalPin<MOSI>::output_high,
+		typename digitalPin<CLK>::output_high
+	>;
+};
+
+extern "C" void config(void) {
+	softwareSPI<2, 3, 4>::init{};
+}
@@ -0,0 +1,7 @@
+#include "registers.h"
+
+void config(void) {
+	REG8(BENCH_TCCR1B) = (1 << 3) | (1 << 1) | (1 << 0);
+	REG16(BENCH_OCR1A) = 249;
+	REG8(BENCH_TIMSK1) = (1 << 1);
+}
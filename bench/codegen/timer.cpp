@@ -0,0 +1,13 @@
+#include "registers.h"
+using namespace bench;
+
+// timer 1: CTC mode with TOP = OCR1A, clk / 64, compare A interrupt
+extern "C" void config(void) {
+	initializer<
+		tccr1b::set<3, true>,      // WGM12
+		tccr1b::set<1, true>,      // CS11
+		tccr1b::set<0, true>,      // CS10
+		modifier<ocr1a::address, 0xFFFF, 249, ocr1a::traits>,
+		timsk1::set<1, true>       // OCIE1A
+	>{};
+}
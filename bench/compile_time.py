@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Compile-time scaling benchmark for opti_init.
+
+Generates translation units with initializers of N modifiers spread across
+N / 8 registers, compiles each one and reports compile time and peak compiler
+memory. Results may be saved and compared against a previous run to catch
+regressions:
+
+    bench/compile_time.py -o before.txt
+    bench/compile_time.py --baseline before.txt
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SIZES = [10, 100, 1000, 5000]
+BITS_PER_REGISTER = 8
+
+
+def generate(count):
+	mods = []
+	for i in range(count):
+		reg = i // BITS_PER_REGISTER
+		bit = i % BITS_PER_REGISTER
+		# interleave registers, so that folding has to gather them
+		address = 0x100 + (reg * 7919 % max(1, count // BITS_PER_REGISTER + 1))
+		mods.append("\tmodifier<0x%x, 0x%x, 0x%x>" % (address, 1 << bit, (i & 1) << bit))
+	return (
+		'#include "opti_init.h"\n'
+		"using namespace opti_init;\n"
+		"void init() {\n"
+		"\tinitializer<\n%s\n\t>{};\n"
+		"}\n" % ",\n".join(mods)
+	)
+
+
+def measure(compiler, std, count, extra):
+	with tempfile.TemporaryDirectory() as tmp:
+		source = os.path.join(tmp, "bench_%d.cpp" % count)
+		with open(source, "w") as f:
+			f.write(generate(count))
+		cmd = [compiler, "-std=" + std, "-O2", "-c", "-I" + ROOT, source,
+			"-o", os.path.join(tmp, "bench.o")] + extra
+		start = time.monotonic()
+		process = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+		stderr = process.stderr.read()
+		# rusage of this compiler alone, not the maximum over all children
+		_, status, usage = os.wait4(process.pid, 0)
+		process.returncode = os.waitstatus_to_exitcode(status)
+		elapsed = time.monotonic() - start
+		if process.returncode != 0:
+			sys.stderr.write(stderr.decode()[-2000:])
+			return None
+		return elapsed, usage.ru_maxrss / 1024.0
+
+
+def load(path):
+	results = {}
+	with open(path) as f:
+		for line in f:
+			parts = line.split()
+			if len(parts) == 4 and parts[0] != "std":
+				results[(parts[0], int(parts[1]))] = (float(parts[2]), float(parts[3]))
+	return results
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("--compiler", default=os.environ.get("CXX", "g++"))
+	parser.add_argument("--std", action="append", help="language standard(s), default: c++11 and c++17")
+	parser.add_argument("--sizes", type=int, nargs="+", default=SIZES)
+	parser.add_argument("-o", "--output", help="save results to file")
+	parser.add_argument("--baseline", help="compare with saved results, fail on regression")
+	parser.add_argument("--tolerance", type=float, default=1.25, help="allowed slowdown factor against baseline")
+	parser.add_argument("--memory-tolerance", type=float, default=1.25, help="allowed peak memory growth factor against baseline")
+	parser.add_argument("extra", nargs="*", help="extra compiler flags")
+	args = parser.parse_args()
+
+	lines = ["std modifiers seconds peak_mb"]
+	results = {}
+	for std in args.std or ["c++11", "c++17"]:
+		for count in sorted(args.sizes):
+			measured = measure(args.compiler, std, count, args.extra)
+			if measured is None:
+				lines.append("%s %d failed" % (std, count))
+				continue
+			results[(std, count)] = measured
+			lines.append("%s %d %.3f %.1f" % ((std, count) + measured))
+			print(lines[-1])
+			sys.stdout.flush()
+
+	if args.output:
+		with open(args.output, "w") as f:
+			f.write("\n".join(lines) + "\n")
+
+	failed = any(line.endswith("failed") for line in lines)
+	if args.baseline:
+		for key, (seconds, peak) in sorted(load(args.baseline).items()):
+			if key not in results:
+				continue
+			if results[key][0] > seconds * args.tolerance:
+				print("regression: %s %d took %.3f s, baseline %.3f s" % (key + (results[key][0], seconds)))
+				failed = True
+			if results[key][1] > peak * args.memory_tolerance:
+				print("regression: %s %d used %.1f MB, baseline %.1f MB" % (key + (results[key][1], peak)))
+				failed = True
+	return 1 if failed else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,161 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_CORTEXM_H
+#define OPTI_INIT_CORTEXM_H
+
+namespace opti_init
+{
+	namespace detail
+	{
+		template <access_kind kind, typename M>
+		struct perform_exclusive {
+			static void perform(const register_value_t * values) {
+				perform_element<M>::perform(values);
+			}
+		};
+
+		// exclusive load and store of register width, as byte and halfword registers may not be accessed as words
+		template <typename value_type>
+		struct exclusive_io {
+			static_assert(sizeof(value_type) == 0, "exclusive access is available for 8, 16 and 32-bit registers only");
+		};
+
+		template <>
+		struct exclusive_io<uint8_t> {
+			static const unsigned bytes = 1;
+
+			static uint8_t load(volatile uint8_t * ptr) {
+				uint32_t value;
+				__asm__ __volatile__ ("ldrexb %0, %1" : "=r" (value) : "Q" (*ptr));
+				return uint8_t(value);
+			}
+
+			static uint32_t store(volatile uint8_t * ptr, uint8_t value) {
+				uint32_t failed;
+				__asm__ __volatile__ ("strexb %0, %2, %1" : "=&r" (failed), "=Q" (*ptr) : "r" (uint32_t(value)));
+				return failed;
+			}
+		};
+
+		template <>
+		struct exclusive_io<uint16_t> {
+			static const unsigned bytes = 2;
+
+			static uint16_t load(volatile uint16_t * ptr) {
+				uint32_t value;
+				__asm__ __volatile__ ("ldrexh %0, %1" : "=r" (value) : "Q" (*ptr));
+				return uint16_t(value);
+			}
+
+			static uint32_t store(volatile uint16_t * ptr, uint16_t value) {
+				uint32_t failed;
+				__asm__ __volatile__ ("strexh %0, %2, %1" : "=&r" (failed), "=Q" (*ptr) : "r" (uint32_t(value)));
+				return failed;
+			}
+		};
+
+		template <>
+		struct exclusive_io<uint32_t> {
+			static const unsigned bytes = 4;
+
+			static uint32_t load(volatile uint32_t * ptr) {
+				uint32_t value;
+				__asm__ __volatile__ ("ldrex %0, %1" : "=r" (value) : "Q" (*ptr));
+				return value;
+			}
+
+			static uint32_t store(volatile uint32_t * ptr, uint32_t value) {
+				uint32_t failed;
+				__asm__ __volatile__ ("strex %0, %2, %1" : "=&r" (failed), "=Q" (*ptr) : "r" (value));
+				return failed;
+			}
+		};
+
+		// exception entry and return clear exclusive monitor, so interrupted sequence is retried
+		template <typename M>
+		struct perform_exclusive<rmw_access, M> {
+			typedef typename M::traits::value_type value_type;
+			typedef exclusive_io<value_type> io;
+
+			static void perform(const register_value_t * values) {
+				volatile value_type * ptr = reinterpret_cast<volatile value_type *>(M::traits::space::address(M::address));
+				value_type value;
+				do {
+					value = value_type((io::load(ptr) & value_type(~(M::mask | flag_bits<typename M::traits::access_policy>::value))) | value_type(element_value<M>::get(values)));
+				} while (io::store(ptr, value));
+			}
+		};
+
+		template <typename L>
+		struct perform_exclusive_list {};
+
+		template <>
+		struct perform_exclusive_list<list<>> {
+			static void perform(const register_value_t *) {}
+		};
+
+		template <typename H, typename ...T>
+		struct perform_exclusive_list<list<H, T...>> {
+			static void perform(const register_value_t * values) {
+				perform_exclusive<H::access_method, H>::perform(values);
+				perform_exclusive_list<list<T...>>::perform(values);
+			}
+		};
+	} // namespace detail
+
+	namespace hardware
+	{
+		/*
+		Concurrency-safe list policy for ARMv7-M: every read-modify-write
+		sequence is done with LDREX/STREX and retried if register might be
+		modified in between. No interrupts are masked. Not available on
+		ARMv6-M (Cortex-M0/M0+), which has no exclusive access instructions.
+		*/
+		struct atomic_cortexm {
+			typedef void policy_tag;
+
+			template <typename L>
+			static void perform(const register_value_t * values) {
+				detail::perform_exclusive_list<L>::perform(values);
+			}
+		};
+
+		#ifdef OPTI_INIT_TESTS
+		namespace test
+		{
+			// read-modify-write of narrow register doesn't touch its neighbours
+			using byte_rmw = detail::perform_exclusive<detail::rmw_access, modifier<0x40, 0x03, 0x01, register_traits<0, 0, access::read_write, uint8_t>>>;
+			using halfword_rmw = detail::perform_exclusive<detail::rmw_access, modifier<0x40, 0x03, 0x01, register_traits<0, 0, access::read_write, uint16_t>>>;
+			using word_rmw = detail::perform_exclusive<detail::rmw_access, modifier<0x40, 0x03, 0x01, register_traits<0, 0, access::read_write, uint32_t>>>;
+
+			static_assert(byte_rmw::io::bytes == 1, "byte register should be accessed with ldrexb/strexb");
+			static_assert(halfword_rmw::io::bytes == 2, "halfword register should be accessed with ldrexh/strexh");
+			static_assert(word_rmw::io::bytes == 4, "word register should be accessed with ldrex/strex");
+		}
+		#endif // OPTI_INIT_TESTS
+
+	} // namespace hardware
+
+} // namespace opti_init
+
+#endif // OPTI_INIT_CORTEXM_H
@@ -0,0 +1,394 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_EXPANDER_H
+#define OPTI_INIT_EXPANDER_H
+
+/*
+Registers of I/O expanders on I2C or SPI bus. They are never read: every
+register has a RAM copy, and all registers of one device modified by a list
+are written together, with one bus transaction per run of consecutive
+registers. Bus access is done by transport, a class with static functions
+	void write(uint8_t device, uint8_t first_register, const uint8_t * data, unsigned count);
+	void read(uint8_t device, uint8_t first_register, uint8_t * data, unsigned count);
+where device is bus address (or chip select number), and registers are
+auto-incremented within a transaction.
+*/
+
+namespace opti_init
+{
+	namespace access {
+		// register of bus device, written by the device through RAM copy
+		template <typename device>
+		struct expander {
+			typedef device batch;
+		};
+	}
+
+	namespace detail
+	{
+		template <typename device>
+		struct is_shadowed<access::expander<device>> {
+			static const bool value = true;
+			static const bool skip_unchanged = false;
+		};
+
+		// register modified outside of a list is written alone
+		template <typename device>
+		struct shadow_store<access::expander<device>> {
+			template <typename value_type>
+			static void write(pointer_int_t ptr, value_type value) {
+				device::write(ptr, value);
+			}
+		};
+
+		template <typename L>
+		struct update_shadows {};
+
+		template <typename ...M>
+		struct update_shadows<list<M...>> {
+			static void perform(const register_value_t * values) {
+				int order[] = { 0, (shadow<M::address, typename M::traits>::update(M::mask, element_value<M>::get(values)), 0)... };
+				(void)order;
+			}
+		};
+
+		template <typename M, typename L>
+		struct extend_run {
+			typedef list<list<M>> type;
+		};
+
+		template <typename M, typename ...R, typename ...L>
+		struct extend_run<M, list<list<R...>, L...>> {
+			typedef typename head<list<R...>>::type next;
+
+			typedef typename conditional<
+					M::address + 1 == next::address,
+					list<list<M, R...>, L...>,
+					list<list<M>, list<R...>, L...>
+				>::type type;
+		};
+
+		// registers split into runs of consecutive addresses, keeping their order
+		template <typename L>
+		struct split_runs {};
+
+		template <>
+		struct split_runs<list<>> {
+			typedef list<> type;
+		};
+
+		template <typename M, typename ...T>
+		struct split_runs<list<M, T...>> {
+			typedef typename extend_run<M, typename split_runs<list<T...>>::type>::type type;
+		};
+
+		template <typename M, typename L, typename rank, pointer_int_t base>
+		struct insert_ranked {
+			typedef list<M> type;
+		};
+
+		template <typename M, typename H, typename ...T, typename rank, pointer_int_t base>
+		struct insert_ranked<M, list<H, T...>, rank, base> {
+			static const bool first = rank::of(uint8_t(M::address - base)) <= rank::of(uint8_t(H::address - base));
+
+			typedef typename conditional<
+					first,
+					list<M, H, T...>,
+					typename prepend<H, typename insert_ranked<M, list<T...>, rank, base>::type>::type
+				>::type type;
+		};
+
+		// stable sort of registers by rank of their index
+		template <typename L, typename rank, pointer_int_t base>
+		struct sort_ranked {};
+
+		template <typename rank, pointer_int_t base>
+		struct sort_ranked<list<>, rank, base> {
+			typedef list<> type;
+		};
+
+		template <typename M, typename ...T, typename rank, pointer_int_t base>
+		struct sort_ranked<list<M, T...>, rank, base> {
+			typedef typename insert_ranked<M, typename sort_ranked<list<T...>, rank, base>::type, rank, base>::type type;
+		};
+
+		template <typename device, typename runs>
+		struct write_runs {};
+
+		template <typename device>
+		struct write_runs<device, list<>> {
+			static void perform() {}
+		};
+
+		template <typename device, typename ...M, typename ...R>
+		struct write_runs<device, list<list<M...>, R...>> {
+			static void perform() {
+				const uint8_t data[] = { uint8_t(shadow<M::address, typename M::traits>::value)... };
+				device::write_run(head<list<M...>>::type::address, data, sizeof...(M));
+				write_runs<device, list<R...>>::perform();
+			}
+		};
+	} // namespace detail
+
+	namespace hardware
+	{
+		// registers of expanders are given addresses which are not used by MCU
+		constexpr pointer_int_t expander_base(uint8_t device) {
+			return pointer_int_t(pointer_int_t(0) - 0x8000 + (device & 0x7F) * 0x100);
+		}
+
+		template <typename device, uint8_t index, register_value_t reset = 0, typename value_type_ = uint8_t>
+		struct expander_register : basic_register<
+				device::base + index,
+				register_traits<register_value_t(value_type_(~value_type_(0))), reset, access::expander<device>, value_type_>
+			> {};
+
+		// registers of expander are written in list order
+		struct list_order {
+			static constexpr int of(uint8_t) { return 0; }
+		};
+
+		/*
+		Device with addressed byte registers, e.g. MCP23017 or MCP23S17 in
+		sequential mode. Registers modified by a list are written in order of
+		their rank, then in list order, and registers at consecutive addresses
+		share a transaction.
+		*/
+		template <typename transport, uint8_t device, pointer_int_t base_ = expander_base(device), typename rank = list_order>
+		struct addressed_expander {
+			static const pointer_int_t base = base_;
+
+			template <uint8_t index, register_value_t reset = 0>
+			using reg = expander_register<addressed_expander, index, reset>;
+
+			static void write_run(pointer_int_t first, const uint8_t * data, unsigned count) {
+				transport::write(device, uint8_t(first - base), data, count);
+			}
+
+			static void write(pointer_int_t ptr, uint8_t value) {
+				write_run(ptr, &value, 1);
+			}
+
+			static uint8_t read(uint8_t index) {
+				uint8_t value;
+				transport::read(device, index, &value, 1);
+				return value;
+			}
+
+			template <typename L>
+			static void perform(const register_value_t * values) {
+				detail::update_shadows<L>::perform(values);
+				detail::write_runs<addressed_expander, typename detail::split_runs<
+						typename detail::sort_ranked<L, rank, base>::type
+					>::type>::perform();
+			}
+		};
+
+		/*
+		Chain of 74HC595-style shift registers, with latch on chip select.
+		Whole chain is a single register, output n of the chain is bit n,
+		and it's always written at once, farthest chip first.
+		*/
+		template <typename transport, uint8_t select, unsigned length = 1, pointer_int_t base_ = expander_base(select)>
+		struct shift_register_chain {
+			static_assert(length >= 1 && length <= sizeof(register_value_t), "chain is longer than register value");
+
+			static const pointer_int_t base = base_;
+
+			typedef typename opti_init::detail::conditional<length == 1, uint8_t,
+					typename opti_init::detail::conditional<length == 2, uint16_t,
+						typename opti_init::detail::conditional<length <= 4, uint32_t, uint64_t>::type
+					>::type
+				>::type value_type;
+
+			using outputs = expander_register<shift_register_chain, 0, 0, value_type>;
+
+			template <int index>
+			using pin = typename outputs::template bit<index>;
+
+			static void write(pointer_int_t, value_type value) {
+				uint8_t data[length];
+				for (unsigned i = 0; i < length; i++)
+					data[i] = uint8_t(value >> (8 * (length - 1 - i)));
+				transport::write(select, 0, data, length);
+			}
+
+			template <typename L>
+			static void perform(const register_value_t * values) {
+				detail::update_shadows<L>::perform(values);
+				write(base, detail::shadow<base, typename outputs::traits>::value);
+			}
+		};
+
+		/*
+		MCP23017 (I2C) or MCP23S17 (SPI) 16-bit expander with default register
+		map (IOCON.BANK = 0), port 0 is GPA and port 1 is GPB. Pin types are
+		the same as of MCU pins, e.g. mcp23017<twi, 0x20>::pin<1, 3>::output_high.
+		*/
+		template <typename transport, uint8_t device, pointer_int_t base = expander_base(device)>
+		struct mcp23017 {
+			// output latches and pull-ups are written before directions, so pins switch without glitches
+			struct rank {
+				static constexpr int of(uint8_t index) { return index >= 0x14 ? 0 : (index >= 0x02 ? 1 : 2); }
+			};
+
+			typedef addressed_expander<transport, device, base, rank> expander;
+
+			template <int port>
+			using iodir = typename expander::template reg<0x00 + port, 0xFF>;
+
+			template <int port>
+			using gppu = typename expander::template reg<0x0C + port>;
+
+			template <int port>
+			using olat = typename expander::template reg<0x14 + port>;
+
+			static const uint8_t gpio = 0x12;
+
+			template <int port, int bit>
+			struct pin {
+				static constexpr int bit_index = bit;
+				static constexpr int bit_mask = (1 << bit);
+
+				using input_any = typename iodir<port>::template set<bit, true>;
+				using output_any = typename iodir<port>::template set<bit, false>;
+				using no_pull = typename gppu<port>::template set<bit, false>;
+				using pull_up = typename gppu<port>::template set<bit, true>;
+				using low = typename olat<port>::template set<bit, false>;
+				using high = typename olat<port>::template set<bit, true>;
+
+				using output_low = list< low, output_any >;
+				using output_high = list< high, output_any >;
+
+				using input_floating = list< no_pull, input_any >;
+				using input_pullup = list< pull_up, input_any >;
+
+				using input = input_floating;
+				using output = output_any;
+
+				template <bool value>
+				using set = typename olat<port>::template set<bit, value>;
+
+				// pin level is read over the bus
+				static bool get_f() { return !!(expander::read(gpio + port) & bit_mask); }
+				static void set_f(bool value) { if (value) high::perform(); else low::perform(); }
+			};
+		};
+
+		#ifdef OPTI_INIT_TESTS
+		namespace test
+		{
+			using namespace opti_init::test::utils;
+
+			struct no_transport;
+
+			using chip = mcp23017<no_transport, 0x20>;
+			using device = chip::expander;
+			using other = addressed_expander<no_transport, 0x21>;
+
+			static_assert(device::reg<3>::address == expander_base(0x20) + 3, "expander register address invalid");
+			static_assert(expander_base(0x20) != expander_base(0x21), "expanders should have distinct addresses");
+			static_assert(chip::pin<0, 3>::output_any::presumed::value == 0xF7, "IODIR reset value should be presumed");
+			static_assert(chip::pin<0, 3>::high::is_write_only(), "expander register shouldn't be read");
+
+			// registers of one device are batched in place of the first one
+			using batched = opti_init::detail::batch_plan<opti_init::detail::plan<opti_init::detail::flatten<
+				chip::pin<0, 1>::output_high,
+				modifier<1, 0x1, 0x1>,
+				chip::pin<1, 2>::output_low,
+				other::reg<0>::set<0, true>
+			>::type, false>::type>::type;
+
+			static_assert(is_same<batched, list<
+				opti_init::detail::batched<device, list<
+					modifier<device::base + 0x14, 0x2, 0x2, chip::olat<0>::traits>,
+					modifier<device::base + 0x00, 0x2, 0x0, chip::iodir<0>::traits>,
+					modifier<device::base + 0x15, 0x4, 0x0, chip::olat<1>::traits>,
+					modifier<device::base + 0x01, 0x4, 0x0, chip::iodir<1>::traits>
+				>>,
+				modifier<1, 0x1, 0x1>,
+				opti_init::detail::batched<other, list<other::reg<0>::set<0, true>>>
+			>>::value, "expander registers batched invalid");
+
+			// OLATA, OLATB and IODIRA, IODIRB are written by 2 transactions
+			using sorted = opti_init::detail::sort_ranked<list<
+				modifier<0x14, 1, 1>, modifier<0x00, 1, 1>, modifier<0x15, 1, 1>, modifier<0x01, 1, 1>
+			>, chip::rank, 0>::type;
+			static_assert(is_same<opti_init::detail::split_runs<sorted>::type, list<
+				list<modifier<0x14, 1, 1>, modifier<0x15, 1, 1>>,
+				list<modifier<0x00, 1, 1>, modifier<0x01, 1, 1>>
+			>>::value, "consecutive registers should share transaction");
+			static_assert(is_same<opti_init::detail::split_runs<list<modifier<0x01, 1, 1>, modifier<0x00, 1, 1>>>::type, list<
+				list<modifier<0x01, 1, 1>>, list<modifier<0x00, 1, 1>>
+			>>::value, "registers shouldn't be reordered to share transaction");
+
+			static_assert(is_same<shift_register_chain<no_transport, 1, 2>::value_type, uint16_t>::value, "chain register width invalid");
+
+		#ifdef OPTI_INIT_SIMULATED
+			// expanders on simulated bus; returns number of failed checks
+			inline int run_expander() {
+				using namespace opti_init::simulated;
+				int failed = 0;
+				register_file & file = registers();
+
+				// 16 expander pins are configured with 3 bus transactions (latches, pull-ups, directions), and no register access
+				file.reset();
+				expander_bus().reset();
+				using mock_chip = mcp23017<mock_transport, 0x20>;
+				initializer<
+					mock_chip::pin<0, 0>::output_high, mock_chip::pin<0, 1>::output_low, mock_chip::pin<0, 2>::output_high, mock_chip::pin<0, 3>::output_low,
+					mock_chip::pin<0, 4>::output_high, mock_chip::pin<0, 5>::output_low, mock_chip::pin<0, 6>::output_high, mock_chip::pin<0, 7>::output_low,
+					mock_chip::pin<1, 0>::output_high, mock_chip::pin<1, 1>::output_low, mock_chip::pin<1, 2>::output_high, mock_chip::pin<1, 3>::output_low,
+					mock_chip::pin<1, 4>::output_high, mock_chip::pin<1, 5>::output_low, mock_chip::pin<1, 6>::input_pullup, mock_chip::pin<1, 7>::input_floating
+				>{};
+				failed += file.trace().size() != 0;
+				failed += expander_bus().count(write_access, 0x20) != 3;
+				failed += expander_bus().trace()[0].first_register != 0x14 || expander_bus().trace()[0].data.size() != 2;    // OLATA, OLATB
+				failed += expander_bus().value(0x20, 0x14) != 0x55 || expander_bus().value(0x20, 0x15) != 0x15;
+				failed += expander_bus().value(0x20, 0x00) != 0x00 || expander_bus().value(0x20, 0x01) != 0xC0;
+				failed += expander_bus().value(0x20, 0x0D) != 0x40;
+
+				// pin changed alone is a single byte transaction, other bits are taken from copy
+				expander_bus().reset();
+				mock_chip::pin<0, 1>::set_f(true);
+				failed += expander_bus().trace().size() != 1 || expander_bus().value(0x20, 0x14) != 0x57;
+
+				// shift register chain is written at once
+				expander_bus().reset();
+				using chain = shift_register_chain<mock_transport, 3, 2>;
+				settings< chain::pin<0>::high, chain::pin<9>::high >{};
+				failed += expander_bus().trace().size() != 1;
+				failed += expander_bus().value(3, 0) != 0x02 || expander_bus().value(3, 1) != 0x01;    // farthest chip first
+
+				expander_bus().reset();
+				return failed;
+			}
+		#endif
+		}
+		#endif // OPTI_INIT_TESTS
+
+	} // namespace hardware
+
+} // namespace opti_init
+
+#endif // OPTI_INIT_EXPANDER_H
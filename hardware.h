@@ -29,41 +29,439 @@ namespace opti_init
 {
 	namespace hardware
 	{
-		template <pointer_int_t ptr, int index>
+		template <typename ...P>
+		struct pin_set;
+	}
+
+	namespace detail
+	{
+		// every pin of a bus is a field of runtime value, moved from value bit index to its register bit
+		template <unsigned index, typename ...P>
+		struct bus_fields {
+			typedef list<> write;
+			typedef list<> read;
+		};
+
+		template <unsigned index, typename H, typename ...T>
+		struct bus_fields<index, H, T...> {
+			typedef typename H::port_register_bit out;
+			typedef typename H::pin_register_bit in;
+
+			typedef typename prepend<
+				dynamic_access<out::address, 0, 0, typename out::high::traits, list<dynamic_field<out::bit_mask, out::bit_index - int(index), 0>>>,
+				typename bus_fields<index + 1, T...>::write
+			>::type write;
+
+			typedef typename prepend<
+				dynamic_access<in::address, 0, 0, typename in::high::traits, list<dynamic_field<in::bit_mask, in::bit_index - int(index), 0>>>,
+				typename bus_fields<index + 1, T...>::read
+			>::type read;
+		};
+
+		// one access per register, fields with the same shift merged
+		template <typename L>
+		struct bus_accesses {};
+
+		template <typename ...M>
+		struct bus_accesses<list<M...>> {
+			typedef list<typename merge_access<M>::type...> type;
+		};
+
+		template <unsigned ...I>
+		struct indices {};
+
+		template <typename A, typename B>
+		struct join_indices {};
+
+		template <unsigned ...A, unsigned ...B>
+		struct join_indices<indices<A...>, indices<B...>> {
+			typedef indices<A..., (sizeof...(A) + B)...> type;
+		};
+
+		// 0..N-1, with logarithmic recursion depth
+		template <unsigned N>
+		struct make_indices {
+			typedef typename join_indices<typename make_indices<N / 2>::type, typename make_indices<N - N / 2>::type>::type type;
+		};
+
+		template <>
+		struct make_indices<0> {
+			typedef indices<> type;
+		};
+
+		template <>
+		struct make_indices<1> {
+			typedef indices<0> type;
+		};
+
+		constexpr unsigned first_address(const pointer_int_t * addresses, pointer_int_t address, unsigned begin, unsigned end);
+
+		constexpr unsigned first_address_of_halves(const pointer_int_t * addresses, pointer_int_t address, unsigned lower, unsigned middle, unsigned end) {
+			return lower != middle ? lower : first_address(addresses, address, middle, end);
+		}
+
+		// index of first occurrence of address, or end
+		constexpr unsigned first_address(const pointer_int_t * addresses, pointer_int_t address, unsigned begin, unsigned end) {
+			return end - begin == 0 ? end
+				: end - begin == 1 ? (addresses[begin] == address ? begin : end)
+				: first_address_of_halves(addresses, address, first_address(addresses, address, begin, (begin + end) / 2), (begin + end) / 2, end);
+		}
+
+		constexpr register_value_t port_bits(const pointer_int_t * ports, const register_value_t * bits, pointer_int_t port, unsigned begin, unsigned end) {
+			return end - begin == 0 ? 0
+				: end - begin == 1 ? (ports[begin] == port ? bits[begin] : 0)
+				: port_bits(ports, bits, port, begin, (begin + end) / 2) | port_bits(ports, bits, port, (begin + end) / 2, end);
+		}
+
+		constexpr unsigned nth_flag(const int * flags, unsigned n, unsigned begin, unsigned end);
+
+		constexpr unsigned nth_flag_of_halves(const int * flags, unsigned n, unsigned lower, unsigned begin, unsigned end) {
+			return n < lower ? nth_flag(flags, n, begin, (begin + end) / 2) : nth_flag(flags, n - lower, (begin + end) / 2, end);
+		}
+
+		// index of n-th set flag
+		constexpr unsigned nth_flag(const int * flags, unsigned n, unsigned begin, unsigned end) {
+			return end - begin <= 1 ? begin
+				: nth_flag_of_halves(flags, n, unsigned(count(flags, 1, begin, (begin + end) / 2)), begin, end);
+		}
+
+		// bits of pins in their value registers; direction and input registers use the same bits
+		template <typename ...P>
+		struct pin_bits {
+			static const unsigned size = sizeof...(P);
+
+			static constexpr pointer_int_t ports[] = { P::value_address..., 0 };
+			static constexpr register_value_t bits[] = { register_value_t(P::bit_mask)..., 0 };
+
+			static constexpr register_value_t mask(pointer_int_t port) {
+				return port_bits(ports, bits, port, 0, sizeof...(P));
+			}
+		};
+
+		template <typename ...P>
+		constexpr pointer_int_t pin_bits<P...>::ports[];
+
+		template <typename ...P>
+		constexpr register_value_t pin_bits<P...>::bits[];
+
+		template <typename A, typename B>
+		struct pin_bits_union {
+			static constexpr register_value_t mask(pointer_int_t port) {
+				return A::mask(port) | B::mask(port);
+			}
+		};
+
+		template <typename A, typename B>
+		struct pin_bits_difference {
+			static constexpr register_value_t mask(pointer_int_t port) {
+				return A::mask(port) & ~B::mask(port);
+			}
+		};
+
+		template <typename L>
+		struct pin_traits {
+			typedef unknown_reset type;
+		};
+
+		template <typename H, typename ...T>
+		struct pin_traits<list<H, T...>> {
+			typedef typename H::reset_traits type;
+		};
+
+		// port of a set, evaluated once for all its pins
+		template <typename T, typename B, pointer_int_t port>
+		struct pin_port {
+			static constexpr unsigned first = first_address(T::ports, port, 0, T::size);
+			static constexpr register_value_t mask = B::mask(port);
+		};
+
+		/*
+		Ports of candidate pins which have any bit in the set, each one taken
+		at its first pin; last elements of arrays are placeholders for empty
+		set.
+		*/
+		template <typename B, typename L, typename J = typename make_indices<length<L>::value>::type>
+		struct pin_selection {};
+
+		template <typename B, typename ...P, unsigned ...J>
+		struct pin_selection<B, list<P...>, indices<J...>> {
+			typedef B bits;
+			typedef pin_bits<P...> table;
+
+			static const unsigned size = sizeof...(P);
+
+			static constexpr pointer_int_t directions[] = { P::direction_address..., 0 };
+			static constexpr pointer_int_t inputs[] = { P::read_address..., 0 };
+			static constexpr int selected[] = { (pin_port<table, B, P::value_address>::first == J && pin_port<table, B, P::value_address>::mask != 0)..., 0 };
+
+			static constexpr unsigned registers = count(selected, 1, 0, sizeof...(P));
+		};
+
+		template <typename B, typename ...P, unsigned ...J>
+		constexpr pointer_int_t pin_selection<B, list<P...>, indices<J...>>::directions[];
+
+		template <typename B, typename ...P, unsigned ...J>
+		constexpr pointer_int_t pin_selection<B, list<P...>, indices<J...>>::inputs[];
+
+		template <typename B, typename ...P, unsigned ...J>
+		constexpr int pin_selection<B, list<P...>, indices<J...>>::selected[];
+
+		// n-th register of a selection
+		template <typename S, unsigned n>
+		struct pin_register {
+			static constexpr unsigned pin = nth_flag(S::selected, n, 0, S::size);
+			static constexpr pointer_int_t value_address = S::table::ports[pin];
+			static constexpr pointer_int_t direction_address = S::directions[pin];
+			static constexpr pointer_int_t read_address = S::inputs[pin];
+			static constexpr register_value_t mask = pin_port<typename S::table, typename S::bits, value_address>::mask;
+		};
+
+		// one modifier per register, with bits of all pins of the port
+		template <typename S, typename traits, typename K = typename make_indices<S::registers>::type>
+		struct pin_accesses {};
+
+		template <typename S, typename traits, unsigned ...K>
+		struct pin_accesses<S, traits, indices<K...>> {
+			template <bool value>
+			using values = list<modifier<pin_register<S, K>::value_address, pin_register<S, K>::mask, (value ? pin_register<S, K>::mask : 0), traits>...>;
+
+			template <bool output>
+			using directions = list<modifier<pin_register<S, K>::direction_address, pin_register<S, K>::mask, (output ? pin_register<S, K>::mask : 0), traits>...>;
+
+		#if OPTI_INIT_PIN_TOGGLE
+			using toggle = list<modifier<pin_register<S, K>::read_address, pin_register<S, K>::mask, pin_register<S, K>::mask, toggle_register>...>;
+		#endif
+		};
+
+		template <typename B, typename L>
+		struct pin_operations {
+			typedef B bits;
+			typedef L pins;
+
+			typedef pin_accesses<pin_selection<B, L>, typename pin_traits<L>::type> accesses;
+
+			using low = typename accesses::template values<false>;
+			using high = typename accesses::template values<true>;
+			using input_any = typename accesses::template directions<false>;
+			using output_any = typename accesses::template directions<true>;
+
+			using output_low = list< low, output_any >;
+			using output_high = list< high, output_any >;
+
+			using input_floating = list< low, input_any >;
+			using input_pullup = list< high, input_any >;
+
+			using input = input_floating;
+			using output = output_any;
+
+		#if OPTI_INIT_PIN_TOGGLE
+			using toggle = typename accesses::toggle;
+		#endif
+		};
+
+		template <template <int> class port, int first, typename I>
+		struct port_pins {};
+
+		template <template <int> class port, int first, unsigned ...I>
+		struct port_pins<port, first, indices<I...>> {
+			typedef hardware::pin_set<port<first + int(I)>...> type;
+		};
+	}
+
+	namespace hardware
+	{
+		template <pointer_int_t ptr, int index, typename traits = unknown_reset>
 		struct peripheral_register_bit {
 
+			using value_type = typename traits::value_type;
+
+			static const pointer_int_t address = ptr;
 			static constexpr int bit_index = index;
-			static constexpr int bit_mask = (1 << index);
+			static constexpr register_value_t bit_mask = (register_value_t(1) << index);
 
-			static constexpr peripheral_register_t * pointer() {
-				return reinterpret_cast<peripheral_register_t *>(ptr);
+			static constexpr value_type * pointer() {
+				return reinterpret_cast<value_type *>(ptr);
 			}
 
-			using type = peripheral_register_bit<ptr, index>;
+			using type = peripheral_register_bit<ptr, index, traits>;
 
-			typedef modifier<ptr, bit_mask ,0> low;
-			typedef modifier<ptr, bit_mask, bit_mask> high;
+			typedef modifier<ptr, bit_mask ,0, traits> low;
+			typedef modifier<ptr, bit_mask, bit_mask, traits> high;
 
-			static bool get_f() { return !!(*pointer() & bit_mask); }
-			static void set_f(bool value) { *pointer() = value? *pointer() | bit_mask : *pointer() & ~bit_mask; }
+			static bool get_f() { return !!(detail::current_value<ptr, traits>::get() & bit_mask); }
+			static void set_f(bool value) { if (value) high::perform(); else low::perform(); }
 
 			template <int value>
-			using set = modifier<ptr, bit_mask, value?bit_mask:0>;
+			using set = modifier<ptr, bit_mask, value?bit_mask:0, traits>;
+		};
+
+		/*
+		Multi-bit field of a register, e.g. clock select bits. Its values are
+		checked to fit at compile time, and may be of enum type:
+		tccr0b::field<CS00, 3, clock>::set<clock::div_64>.
+		*/
+		template <pointer_int_t ptr, int offset, int width, typename traits, typename value_enum = register_value_t>
+		struct register_field {
+			using value_type = typename traits::value_type;
+
+			static_assert(offset >= 0 && width > 0 && offset + width <= int(8 * sizeof(value_type)), "field doesn't fit into register");
+
+			static const pointer_int_t address = ptr;
+			static constexpr int field_offset = offset;
+			static constexpr int field_width = width;
+			static constexpr register_value_t max_value = width >= int(8 * sizeof(register_value_t))
+				? register_value_t(~register_value_t(0)) : register_value_t((register_value_t(1) << width) - 1);
+			static constexpr register_value_t mask = max_value << offset;
+
+			template <register_value_t value>
+			struct checked {
+				static_assert(value <= max_value, "value doesn't fit into field");
+
+				typedef modifier<ptr, mask, (value << offset), traits> type;
+			};
+
+			template <value_enum value>
+			using set = typename checked<register_value_t(value)>::type;
+
+			// value known at run time, given to perform() of a list
+			using dynamic = dynamic_modifier<ptr, mask, traits>;
+
+			static value_enum get_f() { return value_enum((detail::current_value<ptr, traits>::get() & mask) >> offset); }
+			static void set_f(value_enum value) { dynamic::perform(register_value_t(value)); }
 		};
 
-		template <pointer_int_t ptr>
-		struct peripheral_register {
-			static constexpr peripheral_register_t * pointer() {
-				return reinterpret_cast<peripheral_register_t *>(ptr);
+		/*
+		Register with given traits: width, presumed (reset) value and access
+		policy. Registers of any kind are declared with it, e.g. by generated
+		device descriptions.
+		*/
+		template <pointer_int_t ptr, typename traits_>
+		struct basic_register {
+			using value_type = typename traits_::value_type;
+			using traits = traits_;
+
+			static const pointer_int_t address = ptr;
+
+			static constexpr value_type * pointer() {
+				return reinterpret_cast<value_type *>(ptr);
 			}
 
 			template <int index>
-			using bit = peripheral_register_bit<ptr, index>;
+			using bit = peripheral_register_bit<ptr, index, traits>;
 
 			template <int index, bool value>
-			using set = typename peripheral_register_bit<ptr, index>::template set<value>;
+			using set = typename peripheral_register_bit<ptr, index, traits>::template set<value>;
+
+			template <int offset, int width, typename value_enum = register_value_t>
+			using field = register_field<ptr, offset, width, traits, value_enum>;
+
+			// shadowed registers return last written value
+			static value_type get_f() { return detail::current_value<ptr, traits>::get(); }
 		};
 
+		/*
+		Register of given width. Register value after reset may be given as
+		optional parameter, e.g. sized_register<uint16_t, (pointer_int_t)(&OCR1A), 0x0000>.
+		It allows initializer to write the register without reading it.
+		*/
+		template <typename value_type_, pointer_int_t ptr, register_value_t ...reset>
+		struct sized_register : basic_register<ptr, typename detail::reset_traits<value_type_, reset...>::type> {
+			static_assert(sizeof...(reset) <= 1, "only one reset value may be specified");
+		};
+
+		// register of natural width, e.g. peripheral_register<(pointer_int_t)(&TCCR0A), 0x00>
+		template <pointer_int_t ptr, register_value_t ...reset>
+		using peripheral_register = sized_register<peripheral_register_t, ptr, reset...>;
+
+		/*
+		Register which is never read: its modifiers take other bits from RAM
+		copy of last written value and do single store. Meant for write-only
+		registers and ones that are slow or unsafe to read. Copy starts from
+		reset value; with skip_unchanged, stores that don't change it are
+		skipped. Register should be written by its modifiers only.
+		*/
+		template <pointer_int_t ptr, register_value_t reset = 0, bool skip_unchanged = false, typename value_type_ = peripheral_register_t>
+		struct shadowed_register : basic_register<ptr, shadowed_traits<reset, skip_unchanged, value_type_>> {};
+
+		/*
+		Flags cleared by writing one, e.g. flag_register<(pointer_int_t)(&TIFR0)>.
+		Modifiers store only the ones they set, so clearing a flag never clears
+		other pending flags, and flag clears may be in the same list as
+		configuration of the peripheral.
+		*/
+		template <pointer_int_t ptr, typename value_type_ = peripheral_register_t>
+		struct flag_register : basic_register<ptr, register_traits<0, 0, access::write_one, value_type_>> {};
+
+		// register that is only read, its modifiers don't compile
+		template <pointer_int_t ptr, typename value_type_ = peripheral_register_t>
+		struct read_only_register : basic_register<ptr, register_traits<0, 0, access::read_only, value_type_>> {};
+
+		/*
+		Register whose bits are cleared by reading it, so it's never read by
+		modifiers: they must cover all its bits, or bits of known reset value
+		should be given with traits.
+		*/
+		template <pointer_int_t ptr, typename value_type_ = peripheral_register_t>
+		struct read_to_clear_register : basic_register<ptr, register_traits<0, 0, access::read_to_clear, value_type_>> {};
+
+		/*
+		Pins of a parallel bus scattered over ports by board routing, e.g.
+		pin_bus<portD<2>, portD<3>, portB<0>, ...>, first pin is bit 0 of the
+		value. write() does one access per port and read() one read per port.
+		Pins that are as far apart in the port as in the value are moved with
+		a single shift and mask, so a byte on one port in order is a plain
+		store. Pins should have port_register_bit and pin_register_bit, as AVR
+		gpio does. Port accesses aren't guarded against interrupts. Bus value
+		is carried as runtime register value, so a bus has at most as many pins
+		as register_value_t has bits (16 on AVR).
+		*/
+		template <typename ...P>
+		struct pin_bus {
+			static_assert(sizeof...(P) <= 8 * sizeof(register_value_t), "bus is wider than runtime register value, split it into several buses");
+
+			using value_type = typename detail::conditional<(sizeof...(P) <= 8), uint8_t,
+				typename detail::conditional<(sizeof...(P) <= 16), uint16_t, uint32_t>::type>::type;
+
+			using write_accesses = typename detail::bus_accesses<typename detail::fold_distinct<typename detail::bus_fields<0, P...>::write>::type>::type;
+			using read_accesses = typename detail::bus_accesses<typename detail::fold_distinct<typename detail::bus_fields<0, P...>::read>::type>::type;
+
+			static void write(value_type value) {
+				register_value_t values[] = { value };
+				write_accesses::perform_raw(values);
+			}
+
+			static value_type read() {
+				return value_type(detail::gather<read_accesses>::get());
+			}
+		};
+
+		/*
+		Set of pins, e.g. pin_set<portA<0>, portA<3>, portB<1>>, configured at
+		once: pin_set<...>::output_low has one modifier per register, with
+		masks of all pins of a port computed directly, so large pin banks
+		don't expand into modifiers of every pin. Sets are combined with
+		pin_union and pin_difference, and port_range<portA, 0, 7> is a set of
+		consecutive pins. Pins should have direction_address, value_address,
+		read_address and bit_mask, as AVR gpio does.
+		*/
+		template <typename ...P>
+		struct pin_set : detail::pin_operations<detail::pin_bits<P...>, list<P...>> {};
+
+		template <typename A, typename B>
+		struct pin_union : detail::pin_operations<
+			detail::pin_bits_union<typename A::bits, typename B::bits>,
+			typename detail::join<typename A::pins, typename B::pins>::type
+		> {};
+
+		template <typename A, typename B>
+		struct pin_difference : detail::pin_operations<
+			detail::pin_bits_difference<typename A::bits, typename B::bits>,
+			typename A::pins
+		> {};
+
+		template <template <int> class port, int first, int last>
+		using port_range = typename detail::port_pins<port, first, typename detail::make_indices<unsigned(last - first + 1)>::type>::type;
+
 		#ifdef OPTI_INIT_TESTS
 		namespace test
 		{
@@ -74,8 +472,8 @@ namespace opti_init
 			using reg = peripheral_register< 1 >;
 			using reg_bit = peripheral_register_bit< 1, 0 >;
 
-			static_assert(reg::pointer() == (peripheral_register_t *)(1), "register pointer invalid");
-			static_assert(reg_bit::pointer() == (peripheral_register_t *)(1), "register bit pointer invalid");
+			static_assert(reg::address == 1, "register pointer invalid");
+			static_assert(reg_bit::address == 1, "register bit pointer invalid");
 			static_assert(reg_bit::bit_index == 0, "register bit index invalid");
 			static_assert(reg_bit::bit_mask == (1 << 0), "register bit mask invalid");
 
@@ -90,6 +488,218 @@ namespace opti_init
 
 			static_assert(is_same<reg_bit::set<0>, reg_mod_low>::value, "peripheral register bit setting type invalid");
 			static_assert(is_same<reg_bit::set<1>, reg_mod_high>::value, "peripheral register bit setting type invalid");
+
+			using reset_reg = peripheral_register< 1, 0x10 >;
+
+			static_assert(is_same<reg::traits, unknown_reset>::value, "register reset value should be unknown by default");
+			static_assert(is_same<reset_reg::traits, known_reset<0x10>>::value, "register reset value invalid");
+			static_assert(is_same<reset_reg::set<0, 1>, modifier<1, (1 << 0), (1 << 0), known_reset<0x10>>>::value, "register reset value isn't passed to modifier");
+			static_assert(reset_reg::bit<0>::high::presumed::is_write_only(), "register with reset value shouldn't be read by initializer");
+			static_assert(reset_reg::bit<0>::high::presumed::value == 0x11, "presumed register value invalid");
+
+			// register width is passed to modifiers
+			using wide_reg = sized_register< uint16_t, 1, 0x0100 >;
+
+			static_assert(is_same<wide_reg::bit<9>::high::value_type, uint16_t>::value, "register width isn't passed to modifier");
+			static_assert(wide_reg::bit<9>::high::mask == 0x0200, "wide register bit mask invalid");
+			static_assert(wide_reg::bit<9>::high::presumed::is_write_only(), "wide register with reset value shouldn't be read by initializer");
+			static_assert(wide_reg::bit<9>::high::presumed::value == 0x0300, "wide register presumed value invalid");
+			static_assert(modifier<1, 0xFFFF, 0, wide_reg::traits>::is_write_only(), "wide register mask should be checked in its width");
+			static_assert(!modifier<1, 0xFF, 0, wide_reg::traits>::is_write_only(), "wide register mask should be checked in its width");
+
+			// multi-bit field is set with single modifier
+			enum class clock { stopped = 0, div_1 = 1, div_8 = 2, div_64 = 3 };
+
+			using clock_select = reset_reg::field<0, 3, clock>;
+
+			static_assert(clock_select::mask == 0x7, "field mask invalid");
+			static_assert(is_same<clock_select::set<clock::div_64>, modifier<1, 0x7, 0x3, known_reset<0x10>>>::value, "enum field value invalid");
+			static_assert(is_same<wide_reg::field<8, 4>::set<0xA>, modifier<1, 0x0F00, 0x0A00, wide_reg::traits>>::value, "field value should be shifted to its offset");
+			static_assert(is_same<wide_reg::field<8, 4>::dynamic, dynamic_modifier<1, 0x0F00, wide_reg::traits>>::value, "dynamic field invalid");
+
+			// shadowed register is never read
+			using shadow_reg = shadowed_register< 1, 0x10 >;
+
+			static_assert(is_same<shadow_reg::set<0, 1>, modifier<1, (1 << 0), (1 << 0), shadowed_traits<0x10>>>::value, "shadowed register traits aren't passed to modifier");
+			static_assert(shadow_reg::bit<0>::high::access_method == opti_init::detail::shadow_access, "shadowed register should be accessed through its copy");
+			static_assert(shadow_reg::bit<0>::high::is_write_only(), "shadowed register shouldn't be read");
+			static_assert(!shadow_reg::bit<0>::high::is_atomic(), "copy update isn't atomic");
+			static_assert(settings<shadow_reg::bit<0>::high, shadow_reg::bit<1>::low>::plan::reads == 0, "shadowed register shouldn't be read by settings");
+			static_assert(settings<shadow_reg::bit<0>::high, shadow_reg::bit<1>::low>::plan::shadowed == 1, "shadowed register accesses counted invalid");
+
+			// flag is cleared with a store of its bit only, folded with other flags
+			using flags = flag_register< 2, uint8_t >;
+
+			static_assert(flags::bit<1>::high::access_method != opti_init::detail::rmw_access, "flag register shouldn't be read-modify-written");
+			static_assert(initializer<flags::bit<0>::high, reset_reg::bit<2>::high, flags::bit<1>::high>::plan::reads == 0, "flag register shouldn't be read");
+			static_assert(is_same<settings<flags::bit<0>::high, flags::bit<1>::high>::plan::modifiers, list<
+				modifier<2, 0x3, 0x3, flags::traits>
+			>>::value, "flag clears should be folded into single store");
+
+			// read-to-clear register is written with stores only
+			using rc_reg = read_to_clear_register< 3, uint8_t >;
+			using rc_reset = register_traits<0xFF, 0x00, access::read_to_clear, uint8_t>;
+
+			static_assert(modifier<3, 0xFF, 0x01, rc_reg::traits>::access_method == opti_init::detail::store_access, "read-to-clear register should be stored");
+			static_assert(opti_init::detail::access_violation<access::read_to_clear, rc_reg::bit<0>::high::access_method>::value == opti_init::detail::read_to_clear_read, "partial write of read-to-clear register should be rejected");
+			static_assert(initializer<modifier<3, 0x01, 0x01, rc_reset>>::plan::reads == 0, "read-to-clear register with reset value should be stored by initializer");
+			static_assert(opti_init::detail::access_violation<access::read_only, opti_init::detail::store_access>::value == opti_init::detail::read_only_written, "read-only register write should be rejected");
+
+			// bus pins are moved in runs: one field per port and shift
+			template <pointer_int_t port, int bit>
+			struct bus_pin {
+				using port_register_bit = peripheral_register_bit<port, bit, known_reset<0, uint8_t>>;
+				using pin_register_bit = peripheral_register_bit<port - 2, bit, register_traits<0, 0, access::read_write, uint8_t>>;
+			};
+
+			using scattered = pin_bus<
+				bus_pin<0x25, 4>, bus_pin<0x25, 5>, bus_pin<0x25, 6>, bus_pin<0x25, 7>,
+				bus_pin<0x2B, 0>, bus_pin<0x2B, 1>, bus_pin<0x2B, 6>, bus_pin<0x25, 0>
+			>;
+
+			static_assert(is_same<scattered::write_accesses, list<
+				opti_init::detail::dynamic_access<0x25, 0, 0, known_reset<0, uint8_t>, list<opti_init::detail::dynamic_field<0xF0, 4, 0>, opti_init::detail::dynamic_field<0x01, -7, 0>>>,
+				opti_init::detail::dynamic_access<0x2B, 0, 0, known_reset<0, uint8_t>, list<opti_init::detail::dynamic_field<0x03, -4, 0>, opti_init::detail::dynamic_field<0x40, 0, 0>>>
+			>>::value, "bus pins should be moved in runs, one access per port");
+			static_assert(is_same<scattered::value_type, uint8_t>::value, "bus value width invalid");
+
+			using in_order = pin_bus<
+				bus_pin<0x25, 0>, bus_pin<0x25, 1>, bus_pin<0x25, 2>, bus_pin<0x25, 3>,
+				bus_pin<0x25, 4>, bus_pin<0x25, 5>, bus_pin<0x25, 6>, bus_pin<0x25, 7>
+			>;
+
+			static_assert(is_same<in_order::read_accesses, list<
+				opti_init::detail::dynamic_access<0x23, 0, 0, register_traits<0, 0, access::read_write, uint8_t>, list<opti_init::detail::dynamic_field<0xFF, 0, 0>>>
+			>>::value, "bus on whole port in order should be read at once");
+			static_assert(is_same<in_order::write_accesses, list<
+				opti_init::detail::dynamic_access<0x25, 0, 0, known_reset<0, uint8_t>, list<opti_init::detail::dynamic_field<0xFF, 0, 0>>>
+			>>::value, "bus on whole port in order should be written at once");
+			static_assert(opti_init::detail::dynamic_access<0x25, 0, 0, known_reset<0, uint8_t>, list<opti_init::detail::dynamic_field<0xFF, 0, 0>>>::access_method == opti_init::detail::store_access, "whole port should be stored without reading");
+
+			// pin sets: registers of each port are written with bits of all its pins
+			template <pointer_int_t port, int bit>
+			struct set_pin {
+				static constexpr pointer_int_t direction_address = port - 1;
+				static constexpr pointer_int_t value_address = port;
+				static constexpr pointer_int_t read_address = port - 2;
+				static constexpr int bit_mask = (1 << bit);
+				using reset_traits = known_reset<0, uint8_t>;
+			};
+
+			template <int bit>
+			using set_port_b = set_pin<0x25, bit>;
+
+			template <int bit>
+			using set_port_d = set_pin<0x2B, bit>;
+
+			using lower_b = port_range<set_port_b, 0, 3>;
+			using scattered_pins = pin_set<set_port_d<7>, set_port_b<5>, set_port_d<0>>;
+
+			static_assert(is_same<lower_b, pin_set<set_port_b<0>, set_port_b<1>, set_port_b<2>, set_port_b<3>>>::value, "port range invalid");
+			static_assert(is_same<scattered_pins::output_high, list<
+				list<modifier<0x2B, 0x81, 0x81, known_reset<0, uint8_t>>, modifier<0x25, 0x20, 0x20, known_reset<0, uint8_t>>>,
+				list<modifier<0x2A, 0x81, 0x81, known_reset<0, uint8_t>>, modifier<0x24, 0x20, 0x20, known_reset<0, uint8_t>>>
+			>>::value, "pins of a port should be set with single modifier per register");
+			static_assert(is_same<pin_union<lower_b, scattered_pins>::input_pullup, list<
+				list<modifier<0x25, 0x2F, 0x2F, known_reset<0, uint8_t>>, modifier<0x2B, 0x81, 0x81, known_reset<0, uint8_t>>>,
+				list<modifier<0x24, 0x2F, 0x00, known_reset<0, uint8_t>>, modifier<0x2A, 0x81, 0x00, known_reset<0, uint8_t>>>
+			>>::value, "union should merge pins of the same port");
+			static_assert(is_same<pin_difference<pin_union<lower_b, scattered_pins>, pin_set<set_port_b<1>, set_port_b<5>>>::output, list<
+				modifier<0x24, 0x0D, 0x0D, known_reset<0, uint8_t>>, modifier<0x2A, 0x81, 0x81, known_reset<0, uint8_t>>
+			>>::value, "difference should remove pins");
+		#if OPTI_INIT_PIN_TOGGLE
+			static_assert(is_same<pin_difference<pin_union<lower_b, scattered_pins>, pin_set<set_port_b<1>, set_port_b<5>>>::toggle, list<
+				modifier<0x23, 0x0D, 0x0D, toggle_register>, modifier<0x29, 0x81, 0x81, toggle_register>
+			>>::value, "difference should toggle remaining pins");
+		#endif
+			static_assert(is_same<pin_difference<lower_b, port_range<set_port_b, 0, 7>>::output, list<>>::value, "ports without pins left shouldn't be accessed");
+			static_assert(initializer<pin_union<port_range<set_port_b, 0, 7>, port_range<set_port_d, 0, 7>>::output_low>::plan::registers == 4, "pin bank should be written with one store per register");
+
+		#ifdef OPTI_INIT_SIMULATED
+			// runtime tests on simulated register file, return number of failed checks
+			inline int run_registers() {
+				using namespace opti_init::simulated;
+				int failed = 0;
+				register_file & file = registers();
+
+				// register bit reads are traced too
+				file.reset();
+				file.preset(0x120, 0x8);
+				failed += !peripheral_register_bit<0x120, 3>::get_f();
+				failed += file.count(read_access, 0x120) != 1;
+
+				// field is read and written as a whole
+				file.reset();
+				file.preset(0x150, 0xA5);
+				using field = sized_register<uint8_t, 0x150>::field<2, 3>;
+				failed += field::get_f() != 0x1;
+				field::set_f(0x6);
+				failed += file.value(0x150) != 0xB9 || file.count(write_access) != 1;
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_shadowed() {
+				using namespace opti_init::simulated;
+				int failed = 0;
+				register_file & file = registers();
+
+				// shadowed register is modified without reading, unchanged value isn't stored again
+				file.reset();
+				file.preset(0x138, 0xFF);
+				using shadow_reg = shadowed_register<0x138, 0x10, true>;
+				settings< shadow_reg::set<0, true> >{};
+				settings< shadow_reg::set<0, true>, shadow_reg::set<4, true> >{};
+				failed += file.count(read_access) != 0;
+				failed += file.count(write_access, 0x138) != 1;
+				failed += file.value(0x138) != 0x11;
+				failed += shadow_reg::get_f() != 0x11;
+				failed += !shadow_reg::bit<4>::get_f() || file.count(read_access) != 0;
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_flags() {
+				using namespace opti_init::simulated;
+				int failed = 0;
+				register_file & file = registers();
+
+				// flags are cleared in the same initializer as configuration: only the flag bits are stored, flag register isn't read
+				file.reset();
+				file.preset(0x158, 0x07);
+				using flags = flag_register<0x158, uint8_t>;
+				initializer< flags::bit<0>::high, sized_register<uint8_t, 0x159, 0>::set<2, true>, flags::bit<2>::high >{};
+				failed += file.count(read_access) != 0;
+				failed += file.count(write_access, 0x158) != 1 || file.value(0x158) != 0x05;
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_pin_bus() {
+				using namespace opti_init::simulated;
+				int failed = 0;
+				register_file & file = registers();
+
+				// bus value is scattered with one access per port and gathered back with one read per port
+				file.reset();
+				file.preset(0x160, 0x0E);
+				file.preset(0x168, 0xFF);
+				using bus = pin_bus<
+					bus_pin<0x162, 4>, bus_pin<0x162, 5>, bus_pin<0x162, 6>, bus_pin<0x162, 7>,
+					bus_pin<0x16A, 0>, bus_pin<0x16A, 1>, bus_pin<0x16A, 6>, bus_pin<0x162, 0>
+				>;
+				bus::write(0xA5);
+				failed += file.count(write_access) != 2 || file.count(read_access) != 2;
+				failed += file.value(0x162) != 0x51 || file.value(0x16A) != 0x02;
+				failed += bus::read() != 0x70 || file.count(read_access, 0x160) != 1 || file.count(read_access, 0x168) != 1;
+
+				file.reset();
+				return failed;
+			}
+		#endif
 		}
 		#endif // OPTI_INIT_TESTS
 
@@ -99,8 +709,13 @@ namespace opti_init
 
 #ifdef __AVR__
 	#include "avr.h"
+	#include "avr_peripherals.h"
 #elif defined(STM32F0) || defined(STM32F1)
-	//TODO
+	#include "stm32.h"
+#endif
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	#include "cortexm.h"
 #endif
 
 
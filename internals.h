@@ -25,267 +25,2158 @@
 
 #include <stdint.h> // <cstdint> isn't available for e.g. avr-gcc
 
+#if defined(__AVR__)
+	#include <avr/pgmspace.h>
+	#define OPTI_INIT_TABLE_SECTION PROGMEM
+#else
+	#define OPTI_INIT_TABLE_SECTION
+#endif
+
+// writing one to PINx toggles PORTx bit, but PINx of classic AVR parts is read-only
+#ifndef OPTI_INIT_PIN_TOGGLE
+	#if defined(__AVR_ATmega8__) || defined(__AVR_ATmega8A__) || defined(__AVR_ATmega16__) || defined(__AVR_ATmega16A__) \
+		|| defined(__AVR_ATmega32__) || defined(__AVR_ATmega32A__) || defined(__AVR_ATmega64__) || defined(__AVR_ATmega64A__) \
+		|| defined(__AVR_ATmega128__) || defined(__AVR_ATmega128A__) || defined(__AVR_ATmega103__) || defined(__AVR_ATmega161__) \
+		|| defined(__AVR_ATmega162__) || defined(__AVR_ATmega163__) || defined(__AVR_ATmega323__) || defined(__AVR_ATmega8515__) \
+		|| defined(__AVR_ATmega8535__) || defined(__AVR_ATtiny26__)
+		#define OPTI_INIT_PIN_TOGGLE 0
+	#else
+		#define OPTI_INIT_PIN_TOGGLE 1
+	#endif
+#endif
+
 namespace opti_init
 {
 
-	// TODO: add checks for compiler other than gcc
-	#if defined(__AVR__)
-		typedef uint8_t peripheral_register_t;
-		typedef uint16_t pointer_int_t;
-	#elif defined(__arm__)
-		typedef uint32_t peripheral_register_t;
-		typedef uint32_t pointer_int_t;
-	#elif defined(__i386__)
-		typedef uint32_t peripheral_register_t;
-		typedef uint32_t pointer_int_t;
-	#elif defined(__x86_64__)
-		typedef uint64_t peripheral_register_t;
-		typedef uint64_t pointer_int_t;
-	#else
-		typedef uint_fast8_t peripheral_register_t;
-		typedef intptr_t pointer_int_t;
-	#endif
+	// TODO: add checks for compiler other than gcc
+	// register_value_t is wide enough for any register mask or value, while
+	// peripheral_register_t is the natural register width
+	#if defined(__AVR__)
+		typedef uint8_t peripheral_register_t;
+		typedef uint16_t register_value_t;
+		typedef uint16_t pointer_int_t;
+	#elif defined(__arm__)
+		typedef uint32_t peripheral_register_t;
+		typedef uint32_t register_value_t;
+		typedef uint32_t pointer_int_t;
+	#elif defined(__i386__)
+		typedef uint32_t peripheral_register_t;
+		typedef uint32_t register_value_t;
+		typedef uint32_t pointer_int_t;
+	#elif defined(__x86_64__)
+		typedef uint64_t peripheral_register_t;
+		typedef uint64_t register_value_t;
+		typedef uint64_t pointer_int_t;
+	#else
+		typedef uint_fast8_t peripheral_register_t;
+		typedef uintmax_t register_value_t;
+		typedef intptr_t pointer_int_t;
+	#endif
+
+	namespace access {
+		// ordinary register: written bits take written values
+		struct read_write {};
+		// writing one triggers an action (toggles pin, clears flag), writing zero has no effect
+		struct write_one {};
+		// write_one register whose upper half resets what its lower half sets, e.g. STM32 BSRR,
+		// so a later written bit cancels its opposite one
+		struct set_reset {};
+		// write_one register whose ones invert bits, e.g. AVR PINx, so two writes of a bit cancel
+		struct toggle {};
+		// register is never written, e.g. input data or status
+		struct read_only {};
+		// reading clears register bits, so it's only written with stores of all bits
+		struct read_to_clear {};
+		// ordinary register with status flags, e.g. ADIF of AVR ADCSRA, cleared by writing one:
+		// read-modify-write writes flags as zero, so only flags set on purpose are cleared
+		template <register_value_t flags>
+		struct read_write_flags {};
+		// register is never read: bits are taken from RAM copy of last written value,
+		// and the store may be skipped if the value is unchanged
+		template <bool skip_unchanged = false>
+		struct shadowed {};
+	}
+
+	// registers at addresses known at compile time
+	struct absolute_space {
+		static pointer_int_t address(pointer_int_t ptr) { return ptr; }
+	};
+
+	/*
+	Register bits whose values are known in advance, typically reset values.
+	They are never used by settings, but initializer fills all bits not set
+	explicitly with presumed values, so that partially specified register may
+	be written with single store instead of read-modify-write sequence.
+	Register width is a part of traits as well, and address space, which
+	translates register address into the one accessed at run time.
+	*/
+	template <register_value_t presumed_mask_ = 0, register_value_t presumed_value_ = 0, typename access_ = access::read_write, typename value_type_ = peripheral_register_t, typename space_ = absolute_space>
+	struct register_traits {
+		static const register_value_t presumed_mask = presumed_mask_;
+		static const register_value_t presumed_value = presumed_value_ & presumed_mask_;
+		using access_policy = access_;
+		using value_type = value_type_;
+		using space = space_;
+	};
+
+	using unknown_reset = register_traits<>;
+
+	template <register_value_t reset, typename value_type = peripheral_register_t>
+	using known_reset = register_traits<register_value_t(value_type(~value_type(0))), reset, access::read_write, value_type>;
+
+	using write_one_register = register_traits<0, 0, access::write_one>;
+
+	using toggle_register = register_traits<0, 0, access::toggle>;
+
+	// RAM copy starts from reset value
+	template <register_value_t reset = 0, bool skip_unchanged = false, typename value_type = peripheral_register_t>
+	using shadowed_traits = register_traits<register_value_t(value_type(~value_type(0))), reset, access::shadowed<skip_unchanged>, value_type>;
+
+	namespace detail {
+
+		template <typename value_type, register_value_t ...reset>
+		struct reset_traits {
+			typedef register_traits<0, 0, access::read_write, value_type> type;
+		};
+
+		template <typename value_type, register_value_t reset>
+		struct reset_traits<value_type, reset> {
+			typedef known_reset<reset, value_type> type;
+		};
+
+		template <typename T, typename U>
+		struct same_type {
+			static const bool value = false;
+		};
+
+		template <typename T>
+		struct same_type<T, T> {
+			static const bool value = true;
+		};
+
+		template <typename access_policy>
+		struct is_shadowed {
+			static const bool value = false;
+			static const bool skip_unchanged = false;
+		};
+
+		template <bool skip>
+		struct is_shadowed<access::shadowed<skip>> {
+			static const bool value = true;
+			static const bool skip_unchanged = skip;
+		};
+
+		// registers whose written ones are actions and zeroes have no effect
+		template <typename access_policy>
+		struct is_write_one {
+			static const bool value = false;
+		};
+
+		template <>
+		struct is_write_one<access::write_one> {
+			static const bool value = true;
+		};
+
+		template <>
+		struct is_write_one<access::set_reset> {
+			static const bool value = true;
+		};
+
+		template <>
+		struct is_write_one<access::toggle> {
+			static const bool value = true;
+		};
+
+		// bits written as zero by read-modify-write
+		template <typename access_policy>
+		struct flag_bits {
+			static const register_value_t value = 0;
+		};
+
+		template <register_value_t flags>
+		struct flag_bits<access::read_write_flags<flags>> {
+			static const register_value_t value = flags;
+		};
+
+		template <bool condition, typename A, typename B>
+		struct conditional {
+			typedef A type;
+		};
+
+		template <typename A, typename B>
+		struct conditional<false, A, B> {
+			typedef B type;
+		};
+
+		constexpr bool is_single_bit(register_value_t mask) {
+			return mask != 0 && (mask & (mask - 1)) == 0;
+		}
+
+		template <typename value_type>
+		constexpr bool is_full(register_value_t mask) {
+			return value_type(register_value_t(~mask)) == 0;
+		}
+
+		/*
+		Compile-time cost of register accesses, in cycles and bytes of code.
+		Single-bit access is a bit set/clear instruction which modifies one bit
+		and leaves the others intact without reading them into CPU register.
+		Store is atomic if no interrupt may break it into parts.
+		*/
+		template <pointer_int_t ptr, typename value_type>
+		struct access_cost {
+		#if defined(__AVR__)
+			// data space 0x20..0x5f is I/O space reachable by in/out,
+			// its lower half is reachable by sbi/cbi as well;
+			// 16-bit registers are accessed byte by byte
+			static const bool io = ptr >= 0x20 && ptr < 0x60;
+			static const int bytes = sizeof(value_type);
+			static const bool single_bit_available = bytes == 1 && ptr >= 0x20 && ptr < 0x40;
+			static const bool atomic_store = bytes == 1;
+
+			static const int store_cycles = bytes * (io ? 2 : 3);      // ldi, out | ldi, sts
+			static const int store_bytes = bytes * (io ? 4 : 6);
+			static const int rmw_cycles = bytes * (io ? 4 : 6);        // in, andi, ori, out | lds, andi, ori, sts
+			static const int rmw_bytes = bytes * (io ? 8 : 12);
+			static const int single_bit_cycles = 2;                    // sbi | cbi
+			static const int single_bit_bytes = 2;
+			static const int shadow_cycles = bytes * (io ? 7 : 8);     // lds, andi, ori, sts, out | sts
+			static const int shadow_bytes = bytes * (io ? 14 : 16);
+		#else
+			static const bool single_bit_available = false;
+			static const bool atomic_store = true;
+
+			static const int store_cycles = 1;
+			static const int store_bytes = 1;
+			static const int rmw_cycles = 2;
+			static const int rmw_bytes = 2;
+			static const int single_bit_cycles = 0;
+			static const int single_bit_bytes = 0;
+			static const int shadow_cycles = 3;
+			static const int shadow_bytes = 3;
+		#endif
+		};
+
+		constexpr bool is_cheaper(int cycles1, int bytes1, int cycles2, int bytes2) {
+			return cycles1 < cycles2 || (cycles1 == cycles2 && bytes1 < bytes2);
+		}
+
+		/*
+		Raw register reads and writes of given width. Every register access
+		performed by the library goes through it.
+		*/
+		#if defined(OPTI_INIT_SIMULATED)
+		// defined in simulated.h
+		inline register_value_t simulated_read(pointer_int_t ptr, unsigned width);
+		inline void simulated_write(pointer_int_t ptr, unsigned width, register_value_t value);
+
+		template <typename value_type>
+		struct register_io {
+			static value_type read(pointer_int_t ptr) {
+				return value_type(simulated_read(ptr, sizeof(value_type)));
+			}
+
+			static void write(pointer_int_t ptr, value_type value) {
+				simulated_write(ptr, sizeof(value_type), value);
+			}
+		};
+		#else
+		template <typename value_type>
+		struct register_io {
+			static value_type read(pointer_int_t ptr) {
+				return *reinterpret_cast<volatile value_type*>(ptr);
+			}
+
+			static void write(pointer_int_t ptr, value_type value) {
+				*reinterpret_cast<volatile value_type*>(ptr) = value;
+			}
+		};
+		#endif
+
+		#if defined(__AVR__) && !defined(OPTI_INIT_SIMULATED)
+		// 16-bit register pairs share TEMP register: low byte is read first,
+		// and high byte is written first
+		template <>
+		struct register_io<uint16_t> {
+			static uint16_t read(pointer_int_t ptr) {
+				uint8_t low = *reinterpret_cast<volatile uint8_t*>(ptr);
+				uint8_t high = *reinterpret_cast<volatile uint8_t*>(ptr + 1);
+				return (uint16_t(high) << 8) | low;
+			}
+
+			static void write(pointer_int_t ptr, uint16_t value) {
+				*reinterpret_cast<volatile uint8_t*>(ptr + 1) = uint8_t(value >> 8);
+				*reinterpret_cast<volatile uint8_t*>(ptr) = uint8_t(value);
+			}
+		};
+		#endif
+
+		enum access_kind { store_access, rmw_access, single_bit_access, shadow_access };
+
+		template <pointer_int_t ptr, register_value_t mask, typename traits>
+		struct select_access {
+			typedef typename traits::value_type value_type;
+			typedef access_cost<ptr, value_type> cost;
+
+			static const bool write_one = is_write_one<typename traits::access_policy>::value;
+			static const bool shadowed = is_shadowed<typename traits::access_policy>::value;
+			static const bool read_to_clear = same_type<typename traits::access_policy, access::read_to_clear>::value;
+
+			// single bit access is compared to whatever would be done otherwise; it may write flags back on some parts
+			static const bool single_bit = cost::single_bit_available && is_single_bit(mask) && !is_full<value_type>(mask) && !read_to_clear
+				&& flag_bits<typename traits::access_policy>::value == 0
+				&& same_type<typename traits::space, absolute_space>::value && (
+				write_one
+					? is_cheaper(cost::single_bit_cycles, cost::single_bit_bytes, cost::store_cycles, cost::store_bytes)
+					: is_cheaper(cost::single_bit_cycles, cost::single_bit_bytes, cost::rmw_cycles, cost::rmw_bytes)
+			);
+
+			static const access_kind value = shadowed ? shadow_access
+				: (single_bit ? single_bit_access : ((write_one || is_full<value_type>(mask)) ? store_access : rmw_access));
+		};
+
+		enum access_violation_kind { no_violation, read_only_written, read_to_clear_read };
+
+		// access that access policy of register doesn't allow
+		template <typename access_policy, access_kind kind>
+		struct access_violation {
+			static const int value = no_violation;
+		};
+
+		template <access_kind kind>
+		struct access_violation<access::read_only, kind> {
+			static const int value = read_only_written;
+		};
+
+		template <access_kind kind>
+		struct access_violation<access::read_to_clear, kind> {
+			static const int value = kind == store_access ? no_violation : read_to_clear_read;
+		};
+
+		// where shadowed register value is stored to, specialized by off-chip registers
+		template <typename access_policy>
+		struct shadow_store {
+			template <typename value_type>
+			static void write(pointer_int_t ptr, value_type value) {
+				register_io<value_type>::write(ptr, value);
+			}
+		};
+
+		/*
+		RAM copy of last value written to shadowed register. Stores are
+		written through, unless the value is unchanged and skipping is enabled.
+		*/
+		template <pointer_int_t ptr, typename traits>
+		struct shadow {
+			typedef typename traits::value_type value_type;
+
+			static value_type value;
+
+			// returns false if value is unchanged and shouldn't be stored
+			static bool update(register_value_t mask, register_value_t val) {
+				value_type new_value = (value & value_type(~mask)) | value_type(val);
+				if (is_shadowed<typename traits::access_policy>::skip_unchanged && new_value == value)
+					return false;
+				value = new_value;
+				return true;
+			}
+
+			static void write(register_value_t mask, register_value_t val) {
+				if (update(mask, val))
+					shadow_store<typename traits::access_policy>::write(traits::space::address(ptr), value);
+			}
+		};
+
+		template <pointer_int_t ptr, typename traits>
+		typename traits::value_type shadow<ptr, traits>::value = typename traits::value_type(traits::presumed_value);
+
+		// current register value, taken from RAM copy if register is shadowed
+		template <pointer_int_t ptr, typename traits, bool shadowed = is_shadowed<typename traits::access_policy>::value>
+		struct current_value {
+			static typename traits::value_type get() {
+				return register_io<typename traits::value_type>::read(traits::space::address(ptr));
+			}
+		};
+
+		template <pointer_int_t ptr, typename traits>
+		struct current_value<ptr, traits, true> {
+			static typename traits::value_type get() {
+				return shadow<ptr, traits>::value;
+			}
+		};
+
+		template <access_kind kind, pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct perform_access {};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct perform_access<store_access, ptr, mask, val, traits> {
+			static void perform() {
+				register_io<typename traits::value_type>::write(traits::space::address(ptr), val);
+			}
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct perform_access<rmw_access, ptr, mask, val, traits> {
+			typedef typename traits::value_type value_type;
+
+			static void perform() {
+				pointer_int_t address = traits::space::address(ptr);
+				value_type new_value = (register_io<value_type>::read(address) & value_type(~(mask | flag_bits<typename traits::access_policy>::value))) | val;
+				register_io<value_type>::write(address, new_value);
+			}
+		};
+
+		// avr-gcc emits single sbi/cbi for these expressions in lower I/O space
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct perform_access<single_bit_access, ptr, mask, val, traits> {
+			typedef typename traits::value_type value_type;
+
+			static void perform() {
+			#if defined(OPTI_INIT_SIMULATED)
+				// sbi writes its bit only, so a write-one register isn't read
+				perform_access<is_write_one<typename traits::access_policy>::value ? store_access : rmw_access, ptr, mask, val, traits>::perform();
+			#else
+				if (val)
+					*reinterpret_cast<volatile value_type*>(ptr) |= mask;
+				else
+					*reinterpret_cast<volatile value_type*>(ptr) &= value_type(~mask);
+			#endif
+			}
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct perform_access<shadow_access, ptr, mask, val, traits> {
+			static void perform() {
+				shadow<ptr, traits>::write(mask, val);
+			}
+		};
+
+		/*
+		Modifier to be performed by initializer. Bits not set explicitly are
+		taken from presumed value. If it leaves only one bit that differs from
+		presumed value (or is unknown), and single bit access is cheaper than
+		writing the whole register, only that bit is modified.
+		*/
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct presumed_access {
+			typedef access_cost<ptr, typename traits::value_type> cost;
+
+			static const register_value_t full_mask = mask | traits::presumed_mask;
+			static const register_value_t full_value = val | (traits::presumed_value & ~mask);
+			static const register_value_t changed = (mask & ~traits::presumed_mask) | ((val ^ traits::presumed_value) & mask);
+
+			static const bool single_bit = select_access<ptr, changed, traits>::value == single_bit_access && (
+				is_full<typename traits::value_type>(full_mask)
+					? is_cheaper(cost::single_bit_cycles, cost::single_bit_bytes, cost::store_cycles, cost::store_bytes)
+					: true
+			);
+
+			static const register_value_t result_mask = single_bit ? changed : full_mask;
+			static const register_value_t result_value = single_bit ? (val & changed) : full_value;
+		};
+
+	} // namespace detail
+
+	template <pointer_int_t ptr, register_value_t mask_, register_value_t val_, typename traits_ = unknown_reset>
+	struct modifier {
+		modifier(){this->perform();}
+
+		using type = modifier<ptr, mask_, val_, traits_>;
+		using traits = traits_;
+		using value_type = typename traits_::value_type;
+
+		// same modifier with all unset bits taken from presumed register value
+		using presumed = modifier<
+			ptr,
+			detail::presumed_access<ptr, mask_, val_, traits_>::result_mask,
+			detail::presumed_access<ptr, mask_, val_, traits_>::result_value,
+			traits_
+		>;
+
+		static const pointer_int_t address = ptr;
+		static const register_value_t mask = mask_;
+		static const register_value_t value = val_;
+
+		static constexpr value_type * pointer() {
+			return reinterpret_cast<value_type *>(ptr);
+		}
+
+		static const detail::access_kind access_method = detail::select_access<ptr, mask_, traits_>::value;
+
+		static bool constexpr is_write_only() { return detail::is_full<value_type>(mask) || detail::is_write_one<typename traits_::access_policy>::value || access_method == detail::shadow_access; };
+
+		// access can't be broken by an interrupt
+		static bool constexpr is_atomic() { return access_method != detail::rmw_access && access_method != detail::shadow_access && detail::access_cost<ptr, value_type>::atomic_store; }
+
+		static void perform() {
+			static_assert(detail::access_violation<typename traits_::access_policy, access_method>::value != detail::read_only_written, "read-only register can't be written");
+			static_assert(detail::access_violation<typename traits_::access_policy, access_method>::value != detail::read_to_clear_read, "read-to-clear register can't be read: write all its bits or give its reset value");
+			// don't use 'if constexpr' because code should be c++11-compliant
+			detail::perform_access<access_method, ptr, mask_, val_, traits_>::perform();
+		}
+	};
+
+	template<typename ...T>
+	struct list;
+
+	template<typename ...T>
+	struct initializer;
+
+	/*
+	Modifier which value is known at run time only, e.g. PWM duty or timer
+	prescaler. It's folded with other modifiers of the same register, so that
+	constant bits are still combined at compile time and register is accessed
+	once. Values are given to perform() of a list in order of mentioning
+	dynamic modifiers, and are shifted to the lowest bit of mask:
+	settings<timer::mode_ctc, timer::prescaler>::perform(divider).
+	*/
+	template <pointer_int_t ptr, register_value_t mask_, typename traits_ = unknown_reset>
+	struct dynamic_modifier {
+		using traits = traits_;
+
+		static const pointer_int_t address = ptr;
+		static const register_value_t mask = mask_;
+
+		static void perform(register_value_t value) {
+			list<dynamic_modifier>::perform(value);
+		}
+	};
+
+	/*
+	Ordering constraint: register A must be written before register B. A and B
+	may be registers, register bits or modifiers. It may be mentioned in any
+	list along with modifiers. Registers are never split into several accesses,
+	so constraint between two modifiers of same register is ignored.
+	*/
+	template<typename A, typename B>
+	struct before {};
+
+	template<typename ...T>
+	struct sequence;
+
+	/*
+	Components which need a peripheral clock or power gate, e.g.
+	gated<spi_clock_on, spi_master, spi_pins>. Gate is a modifier written
+	before any register of the components. Gates of all components of a list
+	are folded as any other modifiers, so every gate register is written
+	once, however many components need it. It may be mentioned in any list.
+	*/
+	template<typename gate, typename ...T>
+	struct gated {};
+
+	template<typename from, typename to>
+	struct transition;
+
+	/*
+	List policy defines how folded register accesses are performed. It's
+	selected by mentioning it in a list along with modifiers, e.g.
+	settings<atomic_avr, ...>; first mentioned policy is used. By default,
+	accesses aren't protected from interrupts or concurrent modification.
+	*/
+	struct non_atomic {
+		typedef void policy_tag;
+
+		template <typename L>
+		static void perform(const register_value_t * values) {
+			L::perform_raw(values);
+		}
+	};
+
+	struct table_driven;
+
+	namespace detail {
+
+		template<pointer_int_t first_, pointer_int_t second_>
+		struct edge {
+			static const pointer_int_t first = first_;
+			static const pointer_int_t second = second_;
+		};
+
+		template<typename T>
+		struct always_false {
+			static const bool value = false;
+		};
+
+		template<typename H, typename T>
+		struct prepend {};
+
+		template<typename H, typename ...T>
+		struct prepend<H,list<T...>> {
+			typedef list<H,T...> type;
+		};
+
+		template<template<typename...> class F, typename L>
+		struct unpack {};
+
+		template<template<typename...> class F, typename ...T>
+		struct unpack<F, list<T...>> {
+			typedef typename F<T...>::type type;
+		};
+
+		template<template<typename, typename> class F, typename ...T>
+		struct reduce_linear {};
+
+		template<template<typename, typename> class F, typename A>
+		struct reduce_linear<F, A> {
+			typedef A type;
+		};
+
+		template<template<typename, typename> class F, typename A, typename B, typename ...T>
+		struct reduce_linear<F, A, B, T...> {
+			typedef typename reduce_linear<F, typename F<A, B>::type, T...>::type type;
+		};
+
+		// T... reduced by groups of 16, results are put into a list
+		template<template<typename, typename> class F, typename ...T>
+		struct reduce_groups {
+			typedef list<typename reduce_linear<F, T...>::type> type;
+		};
+
+		template<template<typename, typename> class F,
+				typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7,
+				typename T8, typename T9, typename T10, typename T11, typename T12, typename T13, typename T14, typename T15,
+				typename R, typename ...T>
+		struct reduce_groups<F, T0, T1, T2, T3, T4, T5, T6, T7, T8, T9, T10, T11, T12, T13, T14, T15, R, T...> {
+			typedef typename prepend<
+						typename reduce_linear<F, T0, T1, T2, T3, T4, T5, T6, T7, T8, T9, T10, T11, T12, T13, T14, T15>::type,
+						typename reduce_groups<F, R, T...>::type
+				>::type type;
+		};
+
+		/*
+		Associative F applied to all of T..., as a tree of 16-element groups.
+		Instantiation depth and amount of work stay close to linear for long
+		lists, unlike reducing them one element at a time.
+		*/
+		template<template<typename, typename> class F, typename ...T>
+		struct reduce {
+			template<typename ...G>
+			using next = reduce<F, G...>;
+
+			typedef typename unpack<next, typename reduce_groups<F, T...>::type>::type type;
+		};
+
+		template<template<typename, typename> class F, typename T>
+		struct reduce<F, T> {
+			typedef T type;
+		};
+
+		template<typename A, typename B>
+		struct join {};
+
+		template<typename ...A, typename ...B>
+		struct join<list<A...>, list<B...>> {
+			typedef list<A..., B...> type;
+		};
+
+		template<typename L>
+		struct single {
+			typedef void type;
+		};
+
+		template<typename T>
+		struct single<list<T>> {
+			typedef T type;
+		};
+
+		template<typename L>
+		struct empty {
+			typedef list<> type;
+		};
+
+		template<typename ...L>
+		struct join_singles {
+			typedef list<typename single<L>::type...> type;
+		};
+
+		/*
+		Concatenation of any number of lists. Flattened or filtered lists are
+		mostly made of one-element lists only, or of empty lists only, so these
+		are joined at once.
+		*/
+		template<typename ...L>
+		struct concat {
+			typedef typename conditional<
+					same_type<list<L...>, list<list<typename single<L>::type>...>>::value,
+					join_singles<L...>,
+					typename conditional<
+							same_type<list<L...>, list<typename empty<L>::type...>>::value,
+							concat<>,
+							reduce<join, L...>
+						>::type
+				>::type::type type;
+		};
+
+		template<>
+		struct concat<> {
+			typedef list<> type;
+		};
+
+		template<typename T>
+		struct flatten_one {
+			typedef list<T> type;
+		};
+
+		template<typename ...T>
+		struct flatten {
+			typedef typename concat<typename flatten_one<T>::type...>::type type;
+		};
+
+		template<typename ...T>
+		struct flatten_one<list<T...>> {
+			typedef typename flatten<T...>::type type;
+		};
+
+		template<typename ...T>
+		struct flatten_one<initializer<T...>> {
+			typedef typename flatten<T...>::type type;
+		};
+
+		template<typename A, typename B>
+		struct flatten_one<before<A, B>> {
+			typedef list<edge<A::address, B::address>> type;
+		};
+
+		template<typename predicate, typename ...T>
+		struct filter {
+			typedef typename concat<typename conditional<predicate::template apply<T>::value, list<T>, list<>>::type...>::type type;
+		};
+
+		template<typename T>
+		struct is_constraint {
+			static const bool value = false;
+		};
+
+		template<pointer_int_t first, pointer_int_t second>
+		struct is_constraint<edge<first, second>> {
+			static const bool value = true;
+		};
+
+		template<typename T>
+		struct void_type {
+			typedef void type;
+		};
+
+		template<typename T, typename D = void>
+		struct is_policy {
+			static const bool value = false;
+		};
+
+		template<typename T>
+		struct is_policy<T, typename void_type<typename T::policy_tag>::type> {
+			static const bool value = true;
+		};
+
+		enum element_kind { modifier_element, constraint_element, policy_element };
+
+		template<typename T>
+		struct kind_of {
+			static const element_kind value = is_constraint<T>::value ? constraint_element : (is_policy<T>::value ? policy_element : modifier_element);
+		};
+
+		// modifiers are recognized without being instantiated
+		template<pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct kind_of<modifier<ptr, mask, val, traits>> {
+			static const element_kind value = modifier_element;
+		};
+
+		template<pointer_int_t ptr, register_value_t mask, typename traits>
+		struct kind_of<dynamic_modifier<ptr, mask, traits>> {
+			static const element_kind value = modifier_element;
+		};
+
+		template<element_kind kind>
+		struct kind_filter {
+			template <typename T>
+			struct apply {
+				static const bool value = kind_of<T>::value == kind;
+			};
+		};
+
+		template<typename L>
+		struct modifiers_of {};
+
+		template<typename ...T>
+		struct modifiers_of<list<T...>> {
+			typedef typename filter<kind_filter<modifier_element>, T...>::type type;
+		};
+
+		template<typename L>
+		struct constraints_of {};
+
+		template<typename ...T>
+		struct constraints_of<list<T...>> {
+			typedef typename filter<kind_filter<constraint_element>, T...>::type type;
+		};
+
+		template<typename L>
+		struct policies_of {};
+
+		template<typename ...T>
+		struct policies_of<list<T...>> {
+			typedef typename filter<kind_filter<policy_element>, T...>::type type;
+		};
+
+		// bits of runtime value at index, shifted (right if shift is negative) and masked
+		template <register_value_t mask, int shift, unsigned index>
+		struct dynamic_field {};
+
+		constexpr register_value_t shift_value(register_value_t value, int shift) {
+			return shift >= 0 ? (value << shift) : (value >> -shift);
+		}
+
+		template <typename ...F>
+		struct field_bits {
+			static const register_value_t mask = 0;
+
+			static register_value_t value(const register_value_t *) {
+				return 0;
+			}
+
+			static register_value_t gather(register_value_t) {
+				return 0;
+			}
+		};
+
+		template <register_value_t mask_, int shift, unsigned index, typename ...F>
+		struct field_bits<dynamic_field<mask_, shift, index>, F...> {
+			static const register_value_t mask = mask_ | field_bits<F...>::mask;
+
+			static register_value_t value(const register_value_t * values) {
+				return (shift_value(values[index], shift) & mask_) | field_bits<F...>::value(values);
+			}
+
+			// inverse: runtime value gathered from register value, fields of single value
+			static register_value_t gather(register_value_t register_value) {
+				return shift_value(register_value & mask_, -shift) | field_bits<F...>::gather(register_value);
+			}
+		};
+
+		/*
+		Folded access to register modified by both constant and dynamic
+		modifiers: constant bits are combined at compile time, and fields of
+		runtime values are ORed in. Fields and constant bits never overlap.
+		*/
+		template <pointer_int_t ptr, register_value_t static_mask, register_value_t static_value, typename traits_, typename fields>
+		struct dynamic_access {};
+
+		template <pointer_int_t ptr, register_value_t static_mask, register_value_t static_value, typename traits_, typename ...F>
+		struct dynamic_access<ptr, static_mask, static_value, traits_, list<F...>> {
+			using traits = traits_;
+			using value_type = typename traits_::value_type;
+
+			static const pointer_int_t address = ptr;
+			static const register_value_t mask = static_mask | field_bits<F...>::mask;
+			static const register_value_t value = static_value;
+
+			using presumed = dynamic_access<
+				ptr,
+				static_mask | (traits_::presumed_mask & ~mask),
+				static_value | (traits_::presumed_value & ~mask),
+				traits_,
+				list<F...>
+			>;
+
+			// runtime value is never written with single bit access
+			static const access_kind access_method = select_access<ptr, mask, traits_>::value == single_bit_access
+				? rmw_access : select_access<ptr, mask, traits_>::value;
+
+			static bool constexpr is_write_only() { return access_method == store_access || access_method == shadow_access; }
+
+			static bool constexpr is_atomic() { return access_method != rmw_access && access_method != shadow_access && access_cost<ptr, value_type>::atomic_store; }
+
+			static register_value_t runtime_value(const register_value_t * values) {
+				return static_value | field_bits<F...>::value(values);
+			}
+
+			static void perform(const register_value_t * values) {
+				// condition is resolved at compile time
+				if (access_method == shadow_access)
+					shadow<ptr, traits_>::write(mask, runtime_value(values));
+				else if (access_method == store_access)
+					register_io<value_type>::write(traits_::space::address(ptr), value_type(runtime_value(values)));
+				else
+					register_io<value_type>::write(traits_::space::address(ptr), value_type((register_io<value_type>::read(traits_::space::address(ptr)) & value_type(~(mask | flag_bits<typename traits_::access_policy>::value))) | runtime_value(values)));
+			}
+		};
+
+		template <typename M>
+		struct as_dynamic {
+			typedef M type;
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct as_dynamic<modifier<ptr, mask, val, traits>> {
+			typedef dynamic_access<ptr, mask, val, traits, list<>> type;
+		};
+
+		template <typename F, register_value_t later_mask>
+		struct clip_field {};
+
+		template <register_value_t mask, int shift, unsigned index, register_value_t later_mask>
+		struct clip_field<dynamic_field<mask, shift, index>, later_mask> {
+			typedef dynamic_field<mask & ~later_mask, shift, index> type;
+		};
+
+		// bits of A overwritten by B are dropped, both constant and dynamic
+		template <typename A, typename B>
+		struct combine_dynamic {};
+
+		template <pointer_int_t ptr, register_value_t mask1, register_value_t val1, typename traits1, typename ...F1,
+				register_value_t mask2, register_value_t val2, typename traits2, typename ...F2>
+		struct combine_dynamic<dynamic_access<ptr, mask1, val1, traits1, list<F1...>>, dynamic_access<ptr, mask2, val2, traits2, list<F2...>>> {
+			static const register_value_t later_mask = mask2 | field_bits<F2...>::mask;
+
+			typedef dynamic_access<
+				ptr,
+				(mask1 & ~later_mask) | mask2,
+				(val1 & ~later_mask) | val2,
+				traits1,
+				list<typename clip_field<F1, later_mask>::type..., F2...>
+			> type;
+		};
+
+		// fields of the same runtime value with the same shift are moved together
+		template <typename F, typename H, typename T>
+		struct merge_with;
+
+		template <typename F, typename L>
+		struct merge_field {};
+
+		template <typename F>
+		struct merge_field<F, list<>> {
+			typedef list<F> type;
+		};
+
+		template <typename F, typename H, typename ...T>
+		struct merge_field<F, list<H, T...>> {
+			typedef typename merge_with<F, H, list<T...>>::type type;
+		};
+
+		template <typename F, typename H, typename T>
+		struct merge_with {
+			typedef typename prepend<H, typename merge_field<F, T>::type>::type type;
+		};
+
+		template <register_value_t mask1, register_value_t mask2, int shift, unsigned index, typename T>
+		struct merge_with<dynamic_field<mask1, shift, index>, dynamic_field<mask2, shift, index>, T> {
+			typedef typename prepend<dynamic_field<mask1 | mask2, shift, index>, T>::type type;
+		};
+
+		template <typename L, typename R = list<>>
+		struct merge_fields {
+			typedef R type;
+		};
+
+		template <typename H, typename ...T, typename R>
+		struct merge_fields<list<H, T...>, R> {
+			typedef typename merge_fields<list<T...>, typename merge_field<H, R>::type>::type type;
+		};
+
+		template <typename M>
+		struct merge_access {
+			typedef M type;
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename F>
+		struct merge_access<dynamic_access<ptr, mask, val, traits, F>> {
+			typedef dynamic_access<ptr, mask, val, traits, typename merge_fields<F>::type> type;
+		};
+
+		// runtime value gathered back from registers of dynamic accesses, each read once
+		template <typename L>
+		struct gather {
+			static register_value_t get() {
+				return 0;
+			}
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename ...F, typename ...T>
+		struct gather<list<dynamic_access<ptr, mask, val, traits, list<F...>>, T...>> {
+			static register_value_t get() {
+				return field_bits<F...>::gather(current_value<ptr, traits>::get()) | gather<list<T...>>::get();
+			}
+		};
+
+		template<typename M>
+		struct address_of {
+			static const pointer_int_t value = M::address;
+		};
+
+		template<pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct address_of<modifier<ptr, mask, val, traits>> {
+			static const pointer_int_t value = ptr;
+		};
+
+		struct modifier_combine {
+			template <typename A, typename B>
+			struct apply {};
+		};
+
+		// bits of later modifier replace bits of earlier one
+		template <typename access_policy, typename value_type>
+		struct combine_bits {
+			static constexpr register_value_t mask(register_value_t mask1, register_value_t, register_value_t mask2, register_value_t) {
+				return mask1 | mask2;
+			}
+
+			static constexpr register_value_t value(register_value_t, register_value_t val1, register_value_t mask2, register_value_t val2) {
+				return (val1 & ~mask2) | val2;
+			}
+		};
+
+		// set bit cancels earlier reset of the same pin and vice versa, as hardware would give set priority
+		template <typename value_type>
+		struct combine_bits<access::set_reset, value_type> {
+			static constexpr register_value_t opposite(register_value_t bits) {
+				return register_value_t(value_type((bits << (4 * sizeof(value_type))) | (bits >> (4 * sizeof(value_type)))));
+			}
+
+			static constexpr register_value_t mask(register_value_t mask1, register_value_t, register_value_t mask2, register_value_t) {
+				return (mask1 & ~opposite(mask2)) | mask2;
+			}
+
+			static constexpr register_value_t value(register_value_t, register_value_t val1, register_value_t mask2, register_value_t val2) {
+				return (val1 & ~(opposite(mask2) | mask2)) | val2;
+			}
+		};
+
+		// two toggles of a bit cancel each other
+		template <typename value_type>
+		struct combine_bits<access::toggle, value_type> {
+			static constexpr register_value_t mask(register_value_t mask1, register_value_t val1, register_value_t mask2, register_value_t val2) {
+				return (mask1 | mask2) & ~(val1 & val2);
+			}
+
+			static constexpr register_value_t value(register_value_t, register_value_t val1, register_value_t, register_value_t val2) {
+				return val1 ^ val2;
+			}
+		};
+
+		// register traits of the first mentioned modifier are kept
+		template<pointer_int_t ptr1, pointer_int_t ptr2, register_value_t mask1, register_value_t mask2, register_value_t val1, register_value_t val2, typename traits1, typename traits2>
+		struct modifier_combine::apply<modifier<ptr1, mask1, val1, traits1>, modifier<ptr2, mask2, val2, traits2>>
+		{
+			static_assert(ptr1 != ptr2 || same_type<typename traits1::access_policy, typename traits2::access_policy>::value, "register is given different access policies");
+
+			typedef combine_bits<typename traits1::access_policy, typename traits1::value_type> bits;
+
+			typedef modifier<ptr1,
+				(ptr1==ptr2) ? bits::mask(mask1, val1, mask2, val2) : mask1,
+				(ptr1==ptr2) ? bits::value(mask1, val1, mask2, val2) : val1,
+				traits1> type;
+		};
+
+		template<pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename B>
+		struct modifier_combine::apply<modifier<ptr, mask, val, traits>, B>
+		{
+			typedef typename combine_dynamic<typename as_dynamic<modifier<ptr, mask, val, traits>>::type, typename as_dynamic<B>::type>::type type;
+		};
+
+		template<pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename F, typename B>
+		struct modifier_combine::apply<dynamic_access<ptr, mask, val, traits, F>, B>
+		{
+			typedef typename combine_dynamic<dynamic_access<ptr, mask, val, traits, F>, typename as_dynamic<B>::type>::type type;
+		};
+
+		template<typename A>
+		struct not_equal {
+			template <typename B>
+			struct apply {
+				static const bool value = address_of<A>::value != address_of<B>::value;
+			};
+		};
+
+		constexpr unsigned lowest_bit(register_value_t mask) {
+			return (mask == 0 || (mask & 1)) ? 0 : 1 + lowest_bit(mask >> 1);
+		}
+
+		template <typename T>
+		struct is_dynamic {
+			static const bool value = false;
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, typename traits>
+		struct is_dynamic<dynamic_modifier<ptr, mask, traits>> {
+			static const bool value = true;
+		};
+
+		struct dynamic_filter {
+			template <typename T>
+			struct apply : is_dynamic<T> {};
+		};
+
+		// dynamic modifier becomes access with single field, taking value at index
+		template <typename T, unsigned index>
+		struct with_index {
+			typedef T type;
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, typename traits, unsigned index>
+		struct with_index<dynamic_modifier<ptr, mask, traits>, index> {
+			typedef dynamic_access<ptr, 0, 0, traits, list<dynamic_field<mask, lowest_bit(mask), index>>> type;
+		};
+
+		template <unsigned index, typename ...T>
+		struct number_dynamic {
+			typedef list<> type;
+		};
+
+		template <unsigned index, typename H, typename ...T>
+		struct number_dynamic<index, H, T...> {
+			typedef typename prepend<
+						typename with_index<H, index>::type,
+						typename number_dynamic<index + is_dynamic<H>::value, T...>::type
+				>::type type;
+		};
+
+		template <bool dynamic, typename L>
+		struct index_dynamic_impl {
+			typedef L type;
+		};
+
+		template <typename ...T>
+		struct index_dynamic_impl<true, list<T...>> {
+			typedef typename number_dynamic<0, T...>::type type;
+		};
+
+		// dynamic modifiers are numbered in order of mentioning; lists without them are left as is
+		template <typename L>
+		struct index_dynamic {};
+
+		template <typename ...T>
+		struct index_dynamic<list<T...>> : index_dynamic_impl<
+				!same_type<typename filter<dynamic_filter, T...>::type, list<>>::value,
+				list<T...>
+			> {};
+
+		template <typename L>
+		struct length {};
+
+		template <typename ...T>
+		struct length<list<T...>> {
+			static const unsigned value = sizeof...(T);
+		};
+
+		template <typename L>
+		struct dynamic_count {};
+
+		template <typename ...T>
+		struct dynamic_count<list<T...>> {
+			static const unsigned value = length<typename filter<dynamic_filter, T...>::type>::value;
+		};
+
+		// runtime values are given to dynamic accesses only
+		template <typename M>
+		struct perform_element {
+			static void perform(const register_value_t *) {
+				M::perform();
+			}
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename F>
+		struct perform_element<dynamic_access<ptr, mask, val, traits, F>> {
+			static void perform(const register_value_t * values) {
+				dynamic_access<ptr, mask, val, traits, F>::perform(values);
+			}
+		};
+
+		// value written to masked bits, for policies performing accesses themselves
+		template <typename M>
+		struct element_value {
+			static register_value_t get(const register_value_t *) {
+				return M::value;
+			}
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename F>
+		struct element_value<dynamic_access<ptr, mask, val, traits, F>> {
+			static register_value_t get(const register_value_t * values) {
+				return dynamic_access<ptr, mask, val, traits, F>::runtime_value(values);
+			}
+		};
+
+		/*
+		Registers which access policy names a batch (e.g. registers of one
+		bus device) are performed by it together, in place of the first of
+		them: B::perform<list<M...>>(values).
+		*/
+		template <typename B, typename L>
+		struct batched {
+			static const access_kind access_method = shadow_access;
+
+			// never guarded, batch may need interrupts enabled
+			static bool constexpr is_atomic() { return true; }
+
+			static void perform(const register_value_t * values) {
+				B::template perform<L>(values);
+			}
+		};
+
+		template <typename B, typename L>
+		struct perform_element<batched<B, L>> {
+			static void perform(const register_value_t * values) {
+				batched<B, L>::perform(values);
+			}
+		};
+
+		template <typename access_policy, typename D = void>
+		struct policy_batch {
+			typedef void type;
+		};
+
+		template <typename access_policy>
+		struct policy_batch<access_policy, typename void_type<typename access_policy::batch>::type> {
+			typedef typename access_policy::batch type;
+		};
+
+		// looked up once per access policy, not per register
+		template <typename M>
+		struct batch_of {
+			typedef typename policy_batch<typename M::traits::access_policy>::type type;
+		};
+
+		template <typename B>
+		struct batch_filter {
+			template <typename M>
+			struct apply {
+				static const bool value = same_type<typename batch_of<M>::type, B>::value;
+			};
+		};
+
+		template <typename B, typename L>
+		struct batch_members {};
+
+		template <typename B, typename ...M>
+		struct batch_members<B, list<M...>> {
+			typedef typename filter<batch_filter<B>, M...>::type type;
+		};
+
+		template <typename L>
+		struct head {};
+
+		template <typename H, typename ...T>
+		struct head<list<H, T...>> {
+			typedef H type;
+		};
+
+		template <typename M, typename L, typename B = typename batch_of<M>::type>
+		struct batch_element {
+			typedef typename batch_members<B, L>::type members;
+
+			typedef typename conditional<
+					same_type<M, typename head<members>::type>::value,
+					list<batched<B, members>>,
+					list<>
+				>::type type;
+		};
+
+		template <typename M, typename L>
+		struct batch_element<M, L, void> {
+			typedef list<M> type;
+		};
+
+		template <bool any, typename L>
+		struct batch_plan_impl {
+			typedef L type;
+		};
+
+		template <typename ...M>
+		struct batch_plan_impl<true, list<M...>> {
+			typedef typename concat<typename batch_element<M, list<M...>>::type...>::type type;
+		};
+
+		// plan with batched registers replaced by their batches; plans without them are left as is
+		template <typename L>
+		struct batch_plan {};
+
+		template <typename ...M>
+		struct batch_plan<list<M...>> : batch_plan_impl<
+				!same_type<typename batch_members<void, list<M...>>::type, list<M...>>::value,
+				list<M...>
+			> {};
+
+		template<pointer_int_t address, typename M>
+		struct keyed {};
+
+		// modifier of the register in register_map, or void if there is none
+		template<pointer_int_t address, typename M>
+		M find_register(keyed<address, M>*);
+
+		template<pointer_int_t address>
+		void find_register(...);
+
+		// modifiers of distinct registers, accessible by address
+		template<typename ...M>
+		struct register_map : keyed<address_of<M>::value, M>... {};
+
+		template<typename L>
+		struct map_of {};
+
+		template<typename ...M>
+		struct map_of<list<M...>> {
+			typedef register_map<M...> type;
+		};
+
+		template<typename A, typename found>
+		struct combine_found {
+			typedef typename modifier_combine::template apply<A, found>::type type;
+		};
+
+		template<typename A>
+		struct combine_found<A, void> {
+			typedef A type;
+		};
+
+		template<typename B, typename found>
+		struct if_not_found {
+			typedef list<> type;
+		};
+
+		template<typename B>
+		struct if_not_found<B, void> {
+			typedef list<B> type;
+		};
+
+		/*
+		Merges two lists of distinct registers: registers of the second list
+		are folded into the first one, if it mentions them, or appended to it.
+		*/
+		template<typename A, typename B>
+		struct merge_folded {};
+
+		template<typename ...A, typename ...B>
+		struct merge_folded<list<A...>, list<B...>> {
+			typedef register_map<A...> first_map;
+			typedef register_map<B...> second_map;
+
+			typedef typename join<
+					list<typename combine_found<A, decltype(detail::find_register<address_of<A>::value>((second_map*)0))>::type...>,
+					typename concat<typename if_not_found<B, decltype(detail::find_register<address_of<B>::value>((first_map*)0))>::type...>::type
+				>::type type;
+		};
+
+		// every register mentioned once, with all its modifiers combined, in "first mentioned" order
+		template<typename ...T>
+		struct distinct_folded {
+			typedef typename reduce<merge_folded, list<T>...>::type type;
+		};
+
+		template<>
+		struct distinct_folded<> {
+			typedef list<> type;
+		};
+
+		// edges between every register of group A and every register of group B
+		template <typename A, typename L>
+		struct edges_from {};
+
+		template <typename A, typename ...B>
+		struct edges_from<A, list<B...>> {
+			typedef list<edge<A::address, B::address>...> type;
+		};
+
+		template <typename LA, typename LB>
+		struct cross_edges {};
+
+		template <typename ...A, typename LB>
+		struct cross_edges<list<A...>, LB> {
+			typedef typename flatten<typename edges_from<A, LB>::type...>::type type;
+		};
+
+		template <typename ...T>
+		struct sequence_edges {
+			typedef list<> type;
+		};
+
+		template <typename A, typename B, typename ...T>
+		struct sequence_edges<A, B, T...> {
+			typedef typename flatten<
+						typename cross_edges<
+							typename modifiers_of<typename flatten<A>::type>::type,
+							typename modifiers_of<typename flatten<B>::type>::type
+						>::type,
+						typename sequence_edges<B, T...>::type
+				>::type type;
+		};
+
+		template<typename ...T>
+		struct flatten_one<sequence<T...>> {
+			typedef typename flatten<typename flatten<T...>::type, typename sequence_edges<T...>::type>::type type;
+		};
+
+		template<typename gate, typename ...T>
+		struct flatten_one<gated<gate, T...>> {
+			typedef typename flatten_one<sequence<gate, list<T...>>>::type type;
+		};
+
+		template <pointer_int_t address, typename L>
+		struct contains_address {};
+
+		template <pointer_int_t address>
+		struct contains_address<address, list<>> {
+			static const bool value = false;
+		};
+
+		template <pointer_int_t address, typename H, typename ...T>
+		struct contains_address<address, list<H, T...>> {
+			static const bool value = H::address == address || contains_address<address, list<T...>>::value;
+		};
+
+		// modifier may be performed if no other pending register should precede it
+		template <typename M, typename pending, typename edges>
+		struct is_ready {};
+
+		template <typename M, typename pending>
+		struct is_ready<M, pending, list<>> {
+			static const bool value = true;
+		};
+
+		template <typename M, typename pending, typename E, typename ...T>
+		struct is_ready<M, pending, list<E, T...>> {
+			static const bool value =
+				!(E::second == M::address && E::first != M::address && contains_address<E::first, pending>::value)
+				&& is_ready<M, pending, list<T...>>::value;
+		};
+
+		template <typename candidates, typename pending, typename edges>
+		struct pick_ready {
+			static_assert(always_false<candidates>::value, "register ordering constraints are circular");
+		};
+
+		template <bool ready, typename candidates, typename pending, typename edges>
+		struct pick_ready_impl {};
+
+		template <typename H, typename ...T, typename pending, typename edges>
+		struct pick_ready_impl<true, list<H, T...>, pending, edges> {
+			typedef H type;
+		};
+
+		template <typename H, typename ...T, typename pending, typename edges>
+		struct pick_ready_impl<false, list<H, T...>, pending, edges> {
+			typedef typename pick_ready<list<T...>, pending, edges>::type type;
+		};
+
+		template <typename H, typename ...T, typename pending, typename edges>
+		struct pick_ready<list<H, T...>, pending, edges> {
+			typedef typename pick_ready_impl<is_ready<H, pending, edges>::value, list<H, T...>, pending, edges>::type type;
+		};
+
+		/*
+		Topological sort of folded modifiers. Among registers that may be
+		written, the first mentioned one is always taken, so unconstrained
+		registers keep "first mentioned" order.
+		*/
+		template <typename L, typename edges>
+		struct schedule {};
+
+		template <typename edges>
+		struct schedule<list<>, edges> {
+			typedef list<> type;
+		};
+
+		template <typename ...T>
+		struct schedule<list<T...>, list<>> {
+			typedef list<T...> type;
+		};
+
+		template <>
+		struct schedule<list<>, list<>> {
+			typedef list<> type;
+		};
+
+		template <typename H, typename ...T, typename E, typename ...ET>
+		struct schedule<list<H, T...>, list<E, ET...>> {
+			typedef list<E, ET...> edges;
+			typedef typename pick_ready<list<H, T...>, list<H, T...>, edges>::type first;
+			typedef typename prepend<
+						first,
+						typename schedule<typename filter<not_equal<first>, H, T...>::type, edges>::type
+				>::type type;
+		};
+
+		// write-one modifier left without bits, like a pin toggled twice, writes nothing
+		struct has_effect {
+			template <typename M>
+			struct apply {
+				static const bool value = true;
+			};
+		};
+
+		template <pointer_int_t ptr, register_value_t val, typename traits>
+		struct has_effect::apply<modifier<ptr, 0, val, traits>> {
+			static const bool value = !is_write_one<typename traits::access_policy>::value;
+		};
+
+		template <typename ...T>
+		struct effective {
+			typedef typename filter<has_effect, T...>::type type;
+		};
+
+		template <typename T>
+		struct fold_distinct {};
+
+		template <typename ...T>
+		struct fold_distinct<list<T...>> {
+			typedef typename schedule<
+						typename unpack<effective, typename unpack<distinct_folded, typename index_dynamic<typename modifiers_of<list<T...>>::type>::type>::type>::type,
+						typename constraints_of<list<T...>>::type
+				>::type type;
+		};
+
+		template <typename T>
+		struct presume {};
+
+		template <typename ...T>
+		struct presume<list<T...>> {
+			typedef list<typename T::presumed...> type;
+		};
+
+		template <typename L>
+		struct first_policy {
+			typedef non_atomic type;
+		};
+
+		template <typename H, typename ...T>
+		struct first_policy<list<H, T...>> {
+			typedef H type;
+		};
+
+		template <typename L>
+		struct policy_of {
+			typedef typename first_policy<typename policies_of<L>::type>::type type;
+		};
+
+		template <typename L, bool presumed>
+		struct plan {
+			typedef typename fold_distinct<L>::type type;
+		};
+
+		template <typename L>
+		struct plan<L, true> {
+			typedef typename presume<typename fold_distinct<L>::type>::type type;
+		};
+
+		// register state known after a configuration is performed
+		template <typename C>
+		struct known_state {
+			typedef typename fold_distinct<typename flatten<C>::type>::type type;
+		};
+
+		// bits written by initializer, along with presumed ones
+		template <typename M>
+		struct presumed_state {
+			typedef M type;
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct presumed_state<modifier<ptr, mask, val, traits>> {
+			typedef modifier<
+				ptr,
+				presumed_access<ptr, mask, val, traits>::full_mask,
+				presumed_access<ptr, mask, val, traits>::full_value,
+				traits
+			> type;
+		};
+
+		template <typename L>
+		struct presumed_states {};
+
+		template <typename ...M>
+		struct presumed_states<list<M...>> {
+			typedef list<typename presumed_state<M>::type...> type;
+		};
+
+		template <typename ...T>
+		struct known_state<initializer<T...>> {
+			typedef typename presumed_states<typename fold_distinct<typename flatten<T...>::type>::type>::type type;
+		};
+
+		/*
+		Register of target configuration, modified from known state: bits it
+		has in common with the state are presumed, bits that are equal are not
+		written, and the register is dropped if nothing changes. Bits of
+		write_one registers are actions, not state, so only changed ones are
+		written.
+		*/
+		template <typename to, typename from>
+		struct transition_access {
+			typedef list<to> type;
+		};
 
-	template <pointer_int_t ptr, peripheral_register_t mask_, peripheral_register_t val_>
-	struct modifier {
-		modifier(){this->perform();}
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits,
+				register_value_t from_mask, register_value_t from_value, typename from_traits>
+		struct transition_access<modifier<ptr, mask, val, traits>, modifier<ptr, from_mask, from_value, from_traits>> {
+			static const register_value_t changed = mask & ~(from_mask & ~(from_value ^ val));
+			static const bool write_one = is_write_one<typename traits::access_policy>::value;
+
+			typedef register_traits<write_one ? 0 : from_mask, from_value, typename traits::access_policy, typename traits::value_type, typename traits::space> from_state;
+			typedef typename modifier<ptr, changed, val & changed, from_state>::presumed presumed;
+
+			// register traits are kept, shadowed registers are keyed by them
+			typedef typename conditional<
+					changed == 0,
+					list<>,
+					list<modifier<ptr, presumed::mask, presumed::value, traits>>
+				>::type type;
+		};
+
+		template <typename from, typename to>
+		struct transition_modifiers {};
+
+		template <typename from, typename ...M>
+		struct transition_modifiers<from, list<M...>> {
+			typedef typename map_of<from>::type from_map;
+
+			typedef typename concat<
+					typename transition_access<M, decltype(detail::find_register<address_of<M>::value>((from_map*)0))>::type...
+				>::type type;
+		};
+
+		template <typename from, typename to>
+		struct flatten_one<transition<from, to>> {
+			typedef typename flatten<to>::type to_flat;
+
+			typedef typename flatten<
+					typename transition_modifiers<typename known_state<from>::type, typename fold_distinct<to_flat>::type>::type,
+					typename constraints_of<to_flat>::type,
+					typename policies_of<to_flat>::type
+				>::type type;
+		};
 
-		using type = modifier<ptr, mask_, val_>;
+		template <typename M>
+		struct modifier_cost {
+			typedef access_cost<M::address, typename M::value_type> cost;
 
-		static const peripheral_register_t mask = mask_;
-		static const peripheral_register_t value = val_;
+			static const int cycles = M::access_method == store_access ? cost::store_cycles
+				: M::access_method == rmw_access ? cost::rmw_cycles
+				: M::access_method == shadow_access ? cost::shadow_cycles : cost::single_bit_cycles;
+			static const int bytes = M::access_method == store_access ? cost::store_bytes
+				: M::access_method == rmw_access ? cost::rmw_bytes
+				: M::access_method == shadow_access ? cost::shadow_bytes : cost::single_bit_bytes;
+		};
+
+		// modifiers of a plan as arrays, last elements are placeholders for empty plan
+		template <typename ...M>
+		struct plan_table {
+			static constexpr int kinds[] = { M::access_method..., -1 };
+			static constexpr int cycles[] = { modifier_cost<M>::cycles..., 0 };
+			static constexpr int bytes[] = { modifier_cost<M>::bytes..., 0 };
+			static constexpr int violations[] = { access_violation<typename M::traits::access_policy, M::access_method>::value..., no_violation };
+		};
+
+		template <typename ...M>
+		constexpr int plan_table<M...>::kinds[];
+
+		template <typename ...M>
+		constexpr int plan_table<M...>::cycles[];
+
+		template <typename ...M>
+		constexpr int plan_table<M...>::bytes[];
+
+		template <typename ...M>
+		constexpr int plan_table<M...>::violations[];
+
+		// with logarithmic recursion depth, so that plans of any size fit constexpr limits
+		constexpr int sum(const int * values, unsigned begin, unsigned end) {
+			return end - begin == 0 ? 0
+				: end - begin == 1 ? values[begin]
+				: sum(values, begin, (begin + end) / 2) + sum(values, (begin + end) / 2, end);
+		}
 
-		static constexpr peripheral_register_t * pointer() {
-			return reinterpret_cast<peripheral_register_t *>(ptr);
+		constexpr int count(const int * values, int value, unsigned begin, unsigned end) {
+			return end - begin == 0 ? 0
+				: end - begin == 1 ? values[begin] == value
+				: count(values, value, begin, (begin + end) / 2) + count(values, value, (begin + end) / 2, end);
 		}
 
-		static bool constexpr is_write_only() { return (~mask) == 0; };
+		template <typename policy, typename L>
+		struct select_policy {
+			typedef policy type;
+		};
 
-		static void perform() {
-			// typically compiler optimizes it itself, but let's write it explicitly
-			// don't use 'if constexpr' because code should be c++11-compliant
-			if (is_write_only())
-			{
-				*reinterpret_cast<volatile peripheral_register_t*>(ptr) = val_;
-			} else
-			{
-				uint8_t new_value = (*reinterpret_cast<volatile peripheral_register_t*>(ptr) & ~mask_) | val_;
-				*reinterpret_cast<volatile peripheral_register_t*>(ptr) = new_value;
+		#ifdef OPTI_INIT_TABLE_THRESHOLD
+		// long lists with default policy are table-driven
+		template <typename L>
+		struct select_policy<non_atomic, L> {
+			typedef typename conditional<(length<L>::value >= OPTI_INIT_TABLE_THRESHOLD), table_driven, non_atomic>::type type;
+		};
+		#endif
+
+		// every register of folded conditions is read once, until the first mismatch
+		template <typename L>
+		struct conditions_met {
+			static bool check() {
+				return true;
 			}
-		}
-	};
+		};
 
-	template<typename ...T>
-	struct list {};
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits, typename ...T>
+		struct conditions_met<list<modifier<ptr, mask, val, traits>, T...>> {
+			static_assert(!same_type<typename traits::access_policy, access::read_to_clear>::value, "polling read-to-clear register would clear it");
 
-	namespace detail {
+			static bool check() {
+				return (register_value_t(current_value<ptr, traits>::get()) & mask) == val && conditions_met<list<T...>>::check();
+			}
+		};
 
-		template<typename H, typename T>
-		struct prepend {};
+		// register accesses of a plan that access policies of registers allow
+		template <typename L>
+		struct check_access {};
 
-		template<>
-		template<typename H, typename ...T>
-		struct prepend<H,list<T...>> {
-			typedef list<H,T...> type;
+		template <typename ...M>
+		struct check_access<list<M...>> {
+			static_assert(count(plan_table<M...>::violations, read_only_written, 0, sizeof...(M)) == 0, "read-only register can't be written");
+			static_assert(count(plan_table<M...>::violations, read_to_clear_read, 0, sizeof...(M)) == 0, "read-to-clear register can't be read: write all its bits or give its reset value");
+
+			static const bool value = true;
 		};
 
+		// performs flattened list with its policy, values are taken by dynamic modifiers
+		template <typename L, bool presumed = false>
+		struct perform_flat {
+			typedef typename batch_plan<typename plan<L, presumed>::type>::type planned;
 
-		template<bool do_prepend,typename H, typename T>
-		struct conditional_prepend {};
+			static void perform(const register_value_t * values) {
+				static_assert(check_access<typename plan<L, presumed>::type>::value, "register access isn't allowed");
+				select_policy<typename policy_of<L>::type, planned>::type::template perform<planned>(values);
+			}
+		};
 
-		template<>
-		template<typename H, typename T>
-		struct conditional_prepend<true,H,T> {
-			typedef typename prepend<H, T>::type type;
+		template <typename L, typename R = list<>>
+		struct reverse {};
+
+		template <typename R>
+		struct reverse<list<>, R> {
+			typedef R type;
 		};
 
-		template<>
-		template<typename H, typename T>
-		struct conditional_prepend<false, H, T> {
-			typedef T type;
+		template <typename H, typename ...T, typename ...R>
+		struct reverse<list<H, T...>, list<R...>> {
+			typedef typename reverse<list<T...>, list<H, R...>>::type type;
 		};
 
-		template<typename L, typename R>
-		struct concat {};
+		// leading modifiers which are performed atomically
+		template <typename L>
+		struct split_leading {
+			typedef list<> taken;
+			typedef L rest;
+		};
 
-		template<>
-		template<typename ...T>
-		struct concat<list<>,list<T...>> {
-			typedef list<T...> type;
+		template <bool rmw, typename L>
+		struct split_leading_impl {
+			typedef list<> taken;
+			typedef L rest;
 		};
 
-		template<>
-		template<typename H, typename ...T>
-		struct concat<H,list<T...>> {
-			typedef typename concat<typename H::head, list<typename H::last, T...>>::type type;
+		template <typename H, typename ...T>
+		struct split_leading_impl<false, list<H, T...>> {
+			typedef typename prepend<H, typename split_leading<list<T...>>::taken>::type taken;
+			typedef typename split_leading<list<T...>>::rest rest;
 		};
 
-		template<typename ...T>
-		struct flatten {};
+		template <typename H, typename ...T>
+		struct split_leading<list<H, T...>> : split_leading_impl<!H::is_atomic(), list<H, T...>> {};
 
-		template<>
-		struct flatten<> {
-			typedef list<> type;
+		/*
+		Splits folded list so that all non-atomic accesses (read-modify-write
+		sequences, multi-byte stores) are in the middle part, and leading and
+		trailing parts may be performed without protection.
+		*/
+		template <typename L>
+		struct guarded_split {
+			typedef typename split_leading<L>::taken prefix;
+			typedef typename reverse<typename split_leading<L>::rest>::type reversed;
+			typedef typename reverse<typename split_leading<reversed>::taken>::type suffix;
+			typedef typename reverse<typename split_leading<reversed>::rest>::type middle;
 		};
 
-		template<>
-		template<typename ...T>
-		struct flatten<list<T...>> {
-			typedef typename flatten<T...>::type type;
+		template <typename guard, typename L>
+		struct perform_guarded_part {
+			static void perform(const register_value_t * values) {
+				guard g;
+				L::perform_raw(values);
+			}
 		};
 
-		template<>
-		template<typename T>
-		struct flatten<T> {
-			typedef list<T> type;
+		template <typename guard>
+		struct perform_guarded_part<guard, list<>> {
+			static void perform(const register_value_t *) {}
 		};
 
-		template<>
-		template<typename H, typename ...T>
-		struct flatten<H, T...> {
-			typedef typename concat<typename flatten<H>::type,typename flatten<T...>::type>::type type;
+		// performs list with single guard object alive around all non-atomic accesses
+		template <typename guard, typename L>
+		struct perform_guarded {
+			static void perform(const register_value_t * values) {
+				guarded_split<L>::prefix::perform_raw(values);
+				perform_guarded_part<guard, typename guarded_split<L>::middle>::perform(values);
+				guarded_split<L>::suffix::perform_raw(values);
+			}
 		};
 
-		template<typename predicate, typename ...T>
-		struct filter {};
+		template <uint8_t ...B>
+		struct byte_list {};
 
-		template<>
-		template<typename predicate>
-		struct filter<predicate> {
-			typedef list<> type;
+		template <typename A, typename B>
+		struct join_bytes {};
+
+		template <uint8_t ...A, uint8_t ...B>
+		struct join_bytes<byte_list<A...>, byte_list<B...>> {
+			typedef byte_list<A..., B...> type;
 		};
 
-		template<>
-		template<typename predicate, typename H, typename ...T>
-		struct filter<predicate, H, T...> {
-			typedef typename conditional_prepend<predicate::template apply<H>::value,H,typename filter<predicate,T...>::type>::type type;
+		// little-endian bytes of value
+		template <register_value_t value, unsigned count>
+		struct value_bytes {
+			typedef typename join_bytes<byte_list<uint8_t(value & 0xFF)>, typename value_bytes<(value >> 8), count - 1>::type>::type type;
 		};
 
+		template <register_value_t value>
+		struct value_bytes<value, 0> {
+			typedef byte_list<> type;
+		};
 
-		template<typename reducer, typename H, typename ...T>
-		struct fold {};
+		static const uint8_t table_width = 0x0F;
+		static const uint8_t table_rmw = 0x80;
 
-		template<>
-		template<typename reducer, typename A>
-		struct fold<reducer, A> {
-			typedef A type;
+		// only plain register accesses are put into tables
+		template <typename M>
+		struct is_tabulable {
+			static const bool value = false;
 		};
 
-		template<>
-		template<typename reducer, typename A, typename H, typename ...T>
-		struct fold<reducer, A, H, T...> {
-			typedef typename fold<reducer,typename reducer::template apply<A,H>::type,T...>::type type;
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct is_tabulable<modifier<ptr, mask, val, traits>> {
+			static const bool value = modifier<ptr, mask, val, traits>::access_method != shadow_access
+				&& same_type<typename traits::space, absolute_space>::value;
 		};
 
-		struct modifier_combine {
-			template <typename A, typename B>
-			struct apply {};
+		/*
+		Table entry: header byte with register width and access kind, address,
+		value and, for read-modify-write only, mask, which includes flags that
+		are written as zero. Single bit accesses are read-modify-write ones,
+		except to write-one registers, where other bits written back would
+		trigger their actions too.
+		*/
+		template <typename M>
+		struct table_entry {};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct table_entry<modifier<ptr, mask, val, traits>> {
+			static const unsigned width = sizeof(typename traits::value_type);
+			static const access_kind kind = modifier<ptr, mask, val, traits>::access_method;
+			static const bool rmw = kind == rmw_access || (kind == single_bit_access && !is_write_one<typename traits::access_policy>::value);
+
+			typedef typename join_bytes<
+					typename join_bytes<
+						byte_list<uint8_t(width | (rmw ? table_rmw : 0))>,
+						typename value_bytes<register_value_t(ptr), sizeof(pointer_int_t)>::type
+					>::type,
+					typename join_bytes<
+						typename value_bytes<val, width>::type,
+						typename value_bytes<mask | flag_bits<typename traits::access_policy>::value, rmw ? width : 0>::type
+					>::type
+				>::type type;
 		};
 
-		template<>
-		template<pointer_int_t ptr1, pointer_int_t ptr2, peripheral_register_t mask1, peripheral_register_t mask2, peripheral_register_t val1, peripheral_register_t val2>
-		struct modifier_combine::apply<modifier<ptr1, mask1, val1>, modifier<ptr2, mask2, val2>>
-		{
-			typedef modifier<ptr1, (ptr1==ptr2)?(mask1|mask2):mask1, (ptr1==ptr2)?((val1 & ~(mask2))|val2):val1> type;
+		template <typename ...M>
+		struct table_bytes {
+			typedef byte_list<> type;
 		};
 
-		template<typename A>
-		struct not_equal {
-			template <typename B>
-			struct apply {};
+		template <typename M, typename ...T>
+		struct table_bytes<M, T...> {
+			typedef typename join_bytes<typename table_entry<M>::type, typename table_bytes<T...>::type>::type type;
 		};
 
-		template<>
-		template<pointer_int_t ptr1, peripheral_register_t mask1, peripheral_register_t val1>
-		struct not_equal<modifier<ptr1, mask1, val1 >>
-		{
-			template <typename A, typename D = void>
-			struct apply_internal {};
+		template <typename bytes>
+		struct table_data {};
 
-			template <pointer_int_t ptr2, peripheral_register_t mask2, peripheral_register_t val2, typename D>
-			struct apply_internal<modifier<ptr2, mask2, val2 >, D> {
-					static const bool value = ptr1 != ptr2;
-			};
+		// terminated by zero header
+		template <uint8_t ...B>
+		struct table_data<byte_list<B...>> {
+			static const uint8_t bytes[] OPTI_INIT_TABLE_SECTION;
+		};
+
+		template <uint8_t ...B>
+		const uint8_t table_data<byte_list<B...>>::bytes[] OPTI_INIT_TABLE_SECTION = { B..., 0 };
 
-			template <typename A>
-			using apply = apply_internal<A>;
+		inline uint8_t table_byte(const uint8_t * table) {
+		#if defined(__AVR__)
+			return pgm_read_byte(table);
+		#else
+			return *table;
+		#endif
+		}
+
+		inline register_value_t table_value(const uint8_t * & table, unsigned width) {
+			register_value_t value = 0;
+			for (unsigned i = 0; i < width; i++)
+				value |= register_value_t(table_byte(table++)) << (8 * i);
+			return value;
+		}
+
+		template <typename value_type>
+		inline void table_access(pointer_int_t ptr, register_value_t mask, register_value_t value, bool rmw) {
+			if (rmw)
+				value |= register_io<value_type>::read(ptr) & ~mask;
+			register_io<value_type>::write(ptr, value_type(value));
+		}
+
+		// single loop shared by all tables, wider registers are handled only if there may be any
+		__attribute__((noinline)) inline void run_table(const uint8_t * table) {
+			while (uint8_t header = table_byte(table++)) {
+				unsigned width = header & table_width;
+				bool rmw = header & table_rmw;
+				pointer_int_t ptr = pointer_int_t(table_value(table, sizeof(pointer_int_t)));
+				register_value_t value = table_value(table, width);
+				register_value_t mask = rmw ? table_value(table, width) : 0;
+
+				if (width == 1)
+					table_access<uint8_t>(ptr, mask, value, rmw);
+				else if (width == 2)
+					table_access<uint16_t>(ptr, mask, value, rmw);
+				else if (sizeof(register_value_t) >= 4 && width == 4)
+					table_access<uint32_t>(ptr, mask, value, rmw);
+				else if (sizeof(register_value_t) >= 8)
+					table_access<uint64_t>(ptr, mask, value, rmw);
+			}
+		}
+
+		template <typename L>
+		struct table_part {};
+
+		template <typename ...M>
+		struct table_part<list<M...>> {
+			static void perform(const register_value_t *) {
+				run_table(table_data<typename table_bytes<M...>::type>::bytes);
+			}
 		};
 
+		template <typename L>
+		struct perform_element<table_part<L>> {
+			static void perform(const register_value_t * values) {
+				table_part<L>::perform(values);
+			}
+		};
 
-		template<typename ...T>
-		struct distinct_folded {};
+		template <typename M, typename L, bool tabulable = is_tabulable<M>::value>
+		struct extend_table {
+			typedef typename prepend<M, L>::type type;
+		};
 
-		template <typename T>
-		struct fold_distinct {};
+		template <typename M, typename L>
+		struct extend_table<M, L, true> {
+			typedef typename prepend<table_part<list<M>>, L>::type type;
+		};
 
-		template<>
-		template<typename H, typename ...T>
-		struct distinct_folded<H, T...> {
-			typedef typename flatten<
-						typename fold<modifier_combine,H,T...>::type ,
-						typename fold_distinct<typename filter<not_equal<H>,T...>::type>::type
-				 >::type type;
+		template <typename M, typename ...R, typename ...L>
+		struct extend_table<M, list<table_part<list<R...>>, L...>, true> {
+			typedef list<table_part<list<M, R...>>, L...> type;
 		};
 
-		template<>
-		struct distinct_folded<> {
+		// consecutive plain accesses are put into tables, others are kept in place
+		template <typename L>
+		struct table_segments {};
+
+		template <>
+		struct table_segments<list<>> {
 			typedef list<> type;
 		};
 
-		template <>
-		template <typename ...T>
-		struct fold_distinct<list<T...>> {
-			typedef typename distinct_folded<T...>::type type;
+		template <typename M, typename ...T>
+		struct table_segments<list<M, T...>> {
+			typedef typename extend_table<M, typename table_segments<list<T...>>::type>::type type;
 		};
 
 
 	} // namespace detail
 
-	template<>
-	template<typename H>
-	struct list<H> {
-		list(){this->perform();}
+	/*
+	List policy which trades a few cycles per register for code size: folded
+	accesses are encoded into a constant table (in flash on AVR), performed
+	by single loop shared by all lists. Stores take less space than
+	read-modify-write entries, which carry a mask. Accesses which can't be
+	encoded (dynamic, shadowed, batched) are performed in place as usual.
+	It's used instead of default policy for lists of at least
+	OPTI_INIT_TABLE_THRESHOLD registers, if the macro is defined.
+	*/
+	struct table_driven {
+		typedef void policy_tag;
 
-		static void perform_raw() {
-			H::perform();
+		template <typename L>
+		static void perform(const register_value_t * values) {
+			detail::table_segments<L>::type::perform_raw(values);
 		}
+	};
 
-		static void perform(){
-			detail::fold_distinct<typename detail::flatten<H>::type>::type::perform_raw();
-		}
+	/*
+	Register accesses a list performs, known at compile time, e.g.
+	static_assert(my_init::plan::reads == 0, "") or
+	static_assert(my_init::plan::cycles <= 40, ""). Costs are estimated for
+	the target the code is compiled for, and count register accesses only,
+	not guards of list policy.
+	*/
+	template<typename L>
+	struct access_plan {};
+
+	template<typename ...M>
+	struct access_plan<list<M...>> {
+	private:
+		typedef detail::plan_table<M...> table;
+
+	public:
+		typedef list<M...> modifiers;
+
+		static constexpr unsigned registers = sizeof...(M);
+		static constexpr unsigned stores = detail::count(table::kinds, detail::store_access, 0, sizeof...(M));
+		static constexpr unsigned rmws = detail::count(table::kinds, detail::rmw_access, 0, sizeof...(M));
+		static constexpr unsigned single_bits = detail::count(table::kinds, detail::single_bit_access, 0, sizeof...(M));
+		static constexpr unsigned shadowed = detail::count(table::kinds, detail::shadow_access, 0, sizeof...(M));
 
-		typedef list<> head;
-		typedef H last;
+		// single bit and shadowed accesses read no register
+		static constexpr unsigned reads = rmws;
+		static constexpr unsigned writes = registers;
+
+		static constexpr int cycles = detail::sum(table::cycles, 0, sizeof...(M));
+		static constexpr int bytes = detail::sum(table::bytes, 0, sizeof...(M));
 	};
 
-	template<>
-	template<typename H, typename ...T>
-	struct list<H, T...> {
+	template<typename ...T>
+	struct list {
 		list(){this->perform();}
 
-		static void perform_raw() {
-			H::perform();
-			list<T...>::perform_raw();
+		// not instantiated unless used
+		struct plan : access_plan<typename detail::plan<typename detail::flatten<T...>::type, false>::type> {};
+
+		static void perform_raw(const register_value_t * values = 0) {
+		#if __cplusplus >= 201703L
+			(detail::perform_element<T>::perform(values), ...);
+		#else
+			// braced initializer list guarantees left-to-right evaluation
+			int order[] = { 0, (detail::perform_element<T>::perform(values), 0)... };
+			(void)order;
+		#endif
 		}
 
-		static void perform(){
-			detail::fold_distinct<typename detail::flatten<H,T...>::type>::type::perform_raw();
+		// one value is given for every dynamic modifier, in order of mentioning
+		template <typename ...V>
+		static void perform(V... values){
+			typedef typename detail::flatten<T...>::type flat;
+			static_assert(sizeof...(V) == detail::dynamic_count<flat>::value, "every dynamic modifier should be given a value");
+
+			const register_value_t runtime[] = { register_value_t(values)..., 0 };
+			detail::perform_flat<flat>::perform(runtime);
 		}
+	};
+
+	/*
+	initializer is meant for first-time initialization: register bits that are
+	not set explicitly are presumed to have values declared by register traits
+	(reset values), so any register which value is fully known is written with
+	single store, without reading it first. Use it only when registers are
+	known to hold presumed values, e.g. right after MCU reset.
+	*/
+	template <typename ...T>
+	struct initializer {
+		initializer(){this->perform();}
+
+		struct plan : access_plan<typename detail::plan<typename detail::flatten<T...>::type, true>::type> {};
+
+		template <typename ...V>
+		static void perform(V... values){
+			typedef typename detail::flatten<T...>::type flat;
+			static_assert(sizeof...(V) == detail::dynamic_count<flat>::value, "every dynamic modifier should be given a value");
 
-		typedef typename detail::prepend<H,typename list<T...>::head>::type head;
-		typedef typename list<T...>::last last;
+			const register_value_t runtime[] = { register_value_t(values)..., 0 };
+			detail::perform_flat<flat, true>::perform(runtime);
+		}
 	};
 
 	/*
-	By now, initializer and settings are synonyms. Later, presumed register
-	value semantics is going to be implemented with initializer class, so
-	that it may be efficiently used for first-time initialization, and
-	settings will be generic current-state-independent way of writing
-	registers
+	Elements of sequence are performed in order of mentioning: every register
+	of an element is written before any register of the following one. It may
+	be used standalone or mentioned in any list.
 	*/
 	template <typename ...T>
-	using initializer = list<T...>;
+	struct sequence {
+		sequence(){this->perform();}
+
+		struct plan : access_plan<typename detail::plan<typename detail::flatten<sequence<T...>>::type, false>::type> {};
+
+		template <typename ...V>
+		static void perform(V... values){
+			typedef typename detail::flatten<sequence<T...>>::type flat;
+			static_assert(sizeof...(V) == detail::dynamic_count<flat>::value, "every dynamic modifier should be given a value");
+
+			const register_value_t runtime[] = { register_value_t(values)..., 0 };
+			detail::perform_flat<flat>::perform(runtime);
+		}
+	};
+
+	/*
+	Minimal change from one known configuration to another, e.g. between run
+	and sleep pin configurations: only registers and bits of "to" which
+	differ from "from" are written, and registers fully defined by both are
+	written with single store. Register values are presumed to be set by
+	"from" (including reset values if it's an initializer), and it's never
+	performed itself. It may be used standalone or mentioned in any list.
+	*/
+	template <typename from, typename to>
+	struct transition {
+		transition(){this->perform();}
+
+		struct plan : access_plan<typename detail::plan<typename detail::flatten<transition<from, to>>::type, false>::type> {};
+
+		static void perform(){
+			const register_value_t runtime[] = { 0 };
+			detail::perform_flat<typename detail::flatten<transition<from, to>>::type>::perform(runtime);
+		}
+	};
+
+	/*
+	Busy wait until all conditions hold, e.g. wait_until<pll_locked::high,
+	adc_busy::low, tx_empty::high>{}. Conditions are modifiers whose bits are
+	compared instead of written. Conditions of one register are folded, so
+	every poll reads each register once, with a single mask and compare, and
+	stops at the first register that doesn't match.
+	*/
+	template <typename ...C>
+	struct wait_until {
+		wait_until(){this->perform();}
+
+		typedef typename detail::flatten<C...>::type flat;
+		static_assert(detail::dynamic_count<flat>::value == 0, "conditions should be known at compile time");
+
+		typedef typename detail::fold_distinct<flat>::type conditions;
+
+		// registers read by every poll, at most
+		static const unsigned registers = detail::length<conditions>::value;
+
+		static bool met() {
+			return detail::conditions_met<conditions>::check();
+		}
+
+		static void perform() {
+			while (!met()) {}
+		}
+	};
+
+	// wait_until with at most N polls, perform() returns false if conditions aren't met in time
+	template <unsigned long N, typename ...C>
+	struct wait_until_timeout {
+		static bool perform() {
+			for (unsigned long i = 0; i < N; i++)
+				if (wait_until<C...>::met())
+					return true;
+			return false;
+		}
+	};
 
+	/*
+	settings is generic current-state-independent way of writing registers:
+	bits that are not set explicitly are preserved.
+	*/
 	template <typename ...T>
 	using settings = list<T...>;
 
@@ -297,7 +2188,7 @@ namespace opti_init
 			using m = modifier<1, 0x3, 0x1>;
 			static_assert(m::value == 0x1, "value invalid");
 			static_assert(m::mask == 0x3, "mask invalid");
-			static_assert(m::pointer() == (peripheral_register_t *)(1), "pointer invalid");
+			static_assert(m::address == 1, "pointer invalid");
 		};
 
 		struct combine_single_register
@@ -319,6 +2210,249 @@ namespace opti_init
 			static_assert(result::mask == 0x1, "mask invalid on combining modifiers");
 			static_assert(result::value == 0x0, "value invalid on combining modifiers");
 		};
+
+		struct presume_unknown_reset
+		{
+			using result = modifier<1, 0x3, 0x1>::presumed;
+			static_assert(result::mask == 0x3, "mask invalid on presuming unknown value");
+			static_assert(result::value == 0x1, "value invalid on presuming unknown value");
+			static_assert(!result::is_write_only(), "register with unknown value should be read");
+		};
+
+		struct presume_known_reset
+		{
+			using result = modifier<1, 0x3, 0x1, known_reset<0x84>>::presumed;
+			static_assert(result::is_write_only(), "register with known value shouldn't be read");
+			static_assert(result::value == 0x85, "value invalid on presuming known value");
+		};
+
+		struct presume_partially_known
+		{
+			using result = modifier<1, 0x3, 0x1, register_traits<0xF0, 0x5A>>::presumed;
+			static_assert(result::mask == 0xF3, "mask invalid on presuming partially known value");
+			static_assert(result::value == 0x51, "value invalid on presuming partially known value");
+		};
+
+		struct presume_combined
+		{
+			using result = detail::presume<detail::fold_distinct<detail::flatten<
+				modifier<1, 0x1, 0x1, known_reset<0x0>>,
+				modifier<2, 0x1, 0x1>,
+				modifier<1, 0x4, 0x4, known_reset<0x0>>
+			>::type>::type>::type;
+			static_assert(test::utils::is_same<result, list<
+				modifier<1, peripheral_register_t(~peripheral_register_t(0)), 0x5, known_reset<0x0>>,
+				modifier<2, 0x1, 0x1>
+			>>::value, "presumed values invalid on folded list");
+		};
+
+		struct order_first_mentioned
+		{
+			using result = detail::fold_distinct<detail::flatten<
+				modifier<1, 0x1, 0x1>,
+				modifier<2, 0x1, 0x1>,
+				modifier<1, 0x2, 0x2>
+			>::type>::type;
+			static_assert(test::utils::is_same<result, list<
+				modifier<1, 0x3, 0x3>,
+				modifier<2, 0x1, 0x1>
+			>>::value, "unconstrained registers should be written in first mentioned order");
+		};
+
+		struct order_before
+		{
+			using result = detail::fold_distinct<detail::flatten<
+				modifier<1, 0x1, 0x1>,
+				modifier<2, 0x1, 0x1>,
+				modifier<3, 0x1, 0x1>,
+				modifier<1, 0x2, 0x2>,
+				before<modifier<3, 0x1, 0x1>, modifier<1, 0x2, 0x2>>,
+				before<modifier<4, 0x1, 0x1>, modifier<2, 0x2, 0x2>>
+			>::type>::type;
+			static_assert(test::utils::is_same<result, list<
+				modifier<2, 0x1, 0x1>,
+				modifier<3, 0x1, 0x1>,
+				modifier<1, 0x3, 0x3>
+			>>::value, "ordering constraint isn't respected");
+		};
+
+		struct order_sequence
+		{
+			using result = detail::fold_distinct<detail::flatten<
+				modifier<3, 0x1, 0x1>,
+				sequence<
+					list<modifier<1, 0x1, 0x1>, modifier<2, 0x1, 0x1>>,
+					modifier<3, 0x2, 0x2>
+				>,
+				modifier<1, 0x2, 0x2>,
+				sequence<modifier<4, 0x1, 0x1>, modifier<2, 0x2, 0x2>>
+			>::type>::type;
+			static_assert(test::utils::is_same<result, list<
+				modifier<1, 0x3, 0x3>,
+				modifier<4, 0x1, 0x1>,
+				modifier<2, 0x3, 0x3>,
+				modifier<3, 0x3, 0x3>
+			>>::value, "sequence order isn't respected");
+		};
+
+		struct select_policy
+		{
+			struct custom_policy {
+				typedef void policy_tag;
+			};
+
+			static_assert(test::utils::is_same<detail::policy_of<detail::flatten<modifier<1, 0x1, 0x1>>::type>::type, non_atomic>::value, "default policy invalid");
+			static_assert(test::utils::is_same<detail::policy_of<detail::flatten<modifier<1, 0x1, 0x1>, list<custom_policy>>::type>::type, custom_policy>::value, "mentioned policy isn't selected");
+			static_assert(test::utils::is_same<detail::fold_distinct<detail::flatten<modifier<1, 0x1, 0x1>, custom_policy>::type>::type, list<modifier<1, 0x1, 0x1>>>::value, "policy shouldn't be folded as modifier");
+		};
+
+		struct split_guarded
+		{
+			using store1 = modifier<1, peripheral_register_t(~peripheral_register_t(0)), 0x1>;
+			using rmw2 = modifier<2, 0x1, 0x1>;
+			using store3 = modifier<3, peripheral_register_t(~peripheral_register_t(0)), 0x1>;
+			using rmw4 = modifier<4, 0x1, 0x1>;
+			using store5 = modifier<5, peripheral_register_t(~peripheral_register_t(0)), 0x1>;
+
+			using split = detail::guarded_split<list<store1, rmw2, store3, rmw4, store5>>;
+			static_assert(test::utils::is_same<split::prefix, list<store1>>::value, "leading stores shouldn't be guarded");
+			static_assert(test::utils::is_same<split::middle, list<rmw2, store3, rmw4>>::value, "single guard should cover all read-modify-write sequences");
+			static_assert(test::utils::is_same<split::suffix, list<store5>>::value, "trailing stores shouldn't be guarded");
+
+			using stores_only = detail::guarded_split<list<store1, store3>>;
+			static_assert(test::utils::is_same<stores_only::middle, list<>>::value, "stores shouldn't be guarded");
+		};
+
+		struct access_plan_counts
+		{
+			using init = initializer<
+				modifier<1, 0x1, 0x1, known_reset<0>>,
+				modifier<2, 0x1, 0x1>,
+				modifier<1, 0x2, 0x2, known_reset<0>>
+			>;
+			static_assert(init::plan::registers == 2, "registers should be counted once");
+			static_assert(init::plan::stores == 1 && init::plan::rmws == 1, "access kinds counted invalid");
+			static_assert(init::plan::reads == 1 && init::plan::writes == 2, "reads and writes counted invalid");
+			static_assert(init::plan::cycles == detail::access_cost<1, peripheral_register_t>::store_cycles + detail::access_cost<2, peripheral_register_t>::rmw_cycles, "cycles summed invalid");
+
+			static_assert(settings<modifier<1, 0x1, 0x1, known_reset<0>>>::plan::reads == 1, "settings shouldn't presume reset values");
+			static_assert(list<>::plan::registers == 0 && list<>::plan::cycles == 0, "empty plan invalid");
+		};
+
+		struct table_encoding
+		{
+			using byte = register_traits<0, 0, access::read_write, uint8_t>;
+			using store = modifier<1, 0xFF, 0x12, byte>;
+			using rmw = modifier<2, 0x0F, 0x05, byte>;
+			using shadowed = modifier<3, 0x1, 0x1, shadowed_traits<>>;
+
+			static_assert(test::utils::is_same<detail::table_segments<list<store, rmw, shadowed, store>>::type, list<
+				detail::table_part<list<store, rmw>>, shadowed, detail::table_part<list<store>>
+			>>::value, "plain accesses should be put into tables");
+
+			static_assert(test::utils::is_same<detail::table_entry<store>::type, detail::join_bytes<
+				detail::join_bytes<detail::byte_list<1>, detail::value_bytes<1, sizeof(pointer_int_t)>::type>::type,
+				detail::byte_list<0x12>
+			>::type>::value, "store entry should have no mask");
+			static_assert(test::utils::is_same<detail::table_entry<rmw>::type, detail::join_bytes<
+				detail::join_bytes<detail::byte_list<1 | detail::table_rmw>, detail::value_bytes<2, sizeof(pointer_int_t)>::type>::type,
+				detail::byte_list<0x05, 0x0F>
+			>::type>::value, "read-modify-write entry invalid");
+		};
+
+		struct transition_minimal
+		{
+			using byte = register_traits<0, 0, access::read_write, uint8_t>;
+
+			using from = list<
+				modifier<1, 0xFF, 0x12, byte>,
+				modifier<2, 0x0F, 0x05, byte>,
+				modifier<3, 0x01, 0x01, byte>,
+				modifier<5, 0xFF, 0x00, byte>,
+				modifier<6, 0x01, 0x01, write_one_register>
+			>;
+			using to = list<
+				modifier<1, 0x0F, 0x02, byte>,
+				modifier<2, 0x0F, 0x06, byte>,
+				modifier<3, 0x01, 0x01, byte>,
+				modifier<4, 0x01, 0x01, byte>,
+				modifier<5, 0x01, 0x01, byte>,
+				modifier<6, 0x03, 0x03, write_one_register>
+			>;
+
+			static_assert(test::utils::is_same<detail::flatten<transition<from, to>>::type, list<
+				modifier<2, 0x0F, 0x06, byte>,
+				modifier<4, 0x01, 0x01, byte>,
+				modifier<5, 0xFF, 0x01, byte>,
+				modifier<6, 0x02, 0x02, write_one_register>
+			>>::value, "only changed registers and bits should be written");
+			static_assert(transition<from, to>::plan::registers == 4 && transition<from, to>::plan::stores == 2, "fully known registers should be stored");
+
+			// reset values presumed by initializer are known as well
+			using reset_from = initializer<modifier<1, 0x01, 0x01, known_reset<0, uint8_t>>>;
+			static_assert(test::utils::is_same<detail::flatten<transition<reset_from, list<modifier<1, 0x02, 0x02, known_reset<0, uint8_t>>>>>::type, list<
+				modifier<1, 0xFF, 0x03, known_reset<0, uint8_t>>
+			>>::value, "initializer state should include presumed values");
+		};
+
+		struct gate_hoisting
+		{
+			using clock_a = modifier<1, 0x01, 0x01, known_reset<0>>;
+			using clock_b = modifier<1, 0x04, 0x04, known_reset<0>>;
+
+			// peripheral register mentioned before its component, gates of both components folded
+			using components = list<
+				modifier<7, 0x3, 0x1>,
+				gated<clock_a, modifier<7, 0x10, 0x10>, modifier<8, 0x1, 0x1>>,
+				gated<clock_b, list<modifier<9, 0x1, 0x1>>>,
+				gated<clock_a, modifier<10, 0x1, 0x1>>
+			>;
+
+			static_assert(components::plan::registers == 5, "every gate register should be written once");
+			static_assert(test::utils::is_same<components::plan::modifiers, list<
+				modifier<1, 0x05, 0x05, known_reset<0>>,
+				modifier<7, 0x13, 0x11>,
+				modifier<8, 0x1, 0x1>,
+				modifier<9, 0x1, 0x1>,
+				modifier<10, 0x1, 0x1>
+			>>::value, "gates should be folded and written before gated registers");
+		};
+
+		struct wait_conditions
+		{
+			// ready flags of two registers: one compare per register
+			using ready = wait_until<
+				modifier<1, 0x01, 0x01>,
+				modifier<2, 0x80, 0x00>,
+				list<modifier<1, 0x10, 0x10>>
+			>;
+
+			static_assert(test::utils::is_same<ready::conditions, list<
+				modifier<1, 0x11, 0x11>,
+				modifier<2, 0x80, 0x00>
+			>>::value, "conditions of one register should be folded");
+			static_assert(ready::registers == 2, "every register should be read once per poll");
+		};
+
+		struct fold_dynamic
+		{
+			using result = detail::fold_distinct<detail::flatten<
+				modifier<1, 0x3, 0x1>,
+				dynamic_modifier<1, 0x30>,
+				modifier<2, 0x1, 0x1>,
+				modifier<1, 0x10, 0x10>,
+				dynamic_modifier<2, 0x6>
+			>::type>::type;
+
+			static_assert(test::utils::is_same<result, list<
+				detail::dynamic_access<1, 0x13, 0x11, unknown_reset, list<detail::dynamic_field<0x20, 4, 0>>>,
+				detail::dynamic_access<2, 0x1, 0x1, unknown_reset, list<detail::dynamic_field<0x6, 1, 1>>>
+			>>::value, "constant bits should be folded with dynamic modifiers");
+
+			static_assert(detail::dynamic_count<detail::flatten<dynamic_modifier<1, 0x30>, list<dynamic_modifier<2, 0x6>>>::type>::value == 2, "dynamic modifiers counted invalid");
+			static_assert(list<modifier<1, 0x3, 0x1>, dynamic_modifier<1, 0x30>>::plan::registers == 1, "dynamic modifier should share register access");
+			static_assert(initializer<dynamic_modifier<1, 0x30, known_reset<0>>>::plan::stores == 1, "dynamic modifier should be stored when reset value is known");
+		};
 	}
 	#endif // OPTI_INIT_TESTS
 }
@@ -0,0 +1,165 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_MAPPED_H
+#define OPTI_INIT_MAPPED_H
+
+/*
+Register blocks whose base address is known at run time only, e.g. mapped
+with mmap() from /dev/uioN or /dev/mem by a Linux userspace driver, or soft
+peripherals of an FPGA. Registers are declared at offsets within a block,
+and the block is bound to its mapping once:
+	using uart = mapped_block<0>;
+	using uart_control = uart::reg<0x08, uint32_t, 0x0>;
+	uart::bind(mmap(0, 0x1000, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+	initializer< uart_control::bit<0>::high, ... >{};
+Modifiers are folded at compile time as usual, every access just adds the
+base pointer. Blocks are told apart by index, so registers of different
+blocks at the same offset are never folded together. Offsets are limited
+to 2^(6 * sizeof(pointer_int_t)) bytes, e.g. 16 MiB with 32-bit pointers,
+and 4 KiB with 16-bit ones, which fit 15 blocks.
+*/
+
+#if defined(OPTI_INIT_TESTS) && defined(__linux__)
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace opti_init
+{
+	namespace detail
+	{
+		template <typename space, typename value_type, register_value_t ...reset>
+		struct space_traits {
+			typedef register_traits<0, 0, access::read_write, value_type, space> type;
+		};
+
+		template <typename space, typename value_type, register_value_t reset>
+		struct space_traits<space, value_type, reset> {
+			typedef register_traits<register_value_t(value_type(~value_type(0))), reset, access::read_write, value_type, space> type;
+		};
+	}
+
+	namespace hardware
+	{
+		template <unsigned index>
+		struct mapped_block {
+			// blocks are told apart by upper bits of compile-time address, offsets take the lower ones
+			static const unsigned shift = 6 * sizeof(pointer_int_t);
+
+			static_assert(pointer_int_t(index) + 1 < (pointer_int_t(1) << (8 * sizeof(pointer_int_t) - shift)), "too many mapped blocks for address width");
+
+			// compile-time address of block start, distinct for every block
+			static const pointer_int_t link_base = pointer_int_t(pointer_int_t(index + 1) << shift);
+
+			static void bind(volatile void * mapping) {
+				base() = static_cast<volatile uint8_t *>(mapping);
+			}
+
+			static volatile uint8_t * & base() {
+				static volatile uint8_t * pointer = 0;
+				return pointer;
+			}
+
+			// run time address of a register
+			static pointer_int_t address(pointer_int_t ptr) {
+				return pointer_int_t(reinterpret_cast<uintptr_t>(base())) + (ptr - link_base);
+			}
+
+			// register at offset, with optional reset value, e.g. reg<0x10, uint32_t, 0x0>
+			template <pointer_int_t offset>
+			struct checked_offset {
+				static_assert(offset < (pointer_int_t(1) << shift), "offset is beyond block, it would alias the next one");
+				static const pointer_int_t address = link_base + offset;
+			};
+
+			template <pointer_int_t offset, typename value_type = uint32_t, register_value_t ...reset>
+			using reg = basic_register<checked_offset<offset>::address, typename detail::space_traits<mapped_block, value_type, reset...>::type>;
+		};
+
+		#ifdef OPTI_INIT_TESTS
+		namespace test
+		{
+			using namespace opti_init::test::utils;
+
+			using block_a = mapped_block<0>;
+			using block_b = mapped_block<1>;
+
+			static_assert(block_a::reg<0x10>::address == block_a::link_base + 0x10, "mapped register address invalid");
+			static_assert(block_a::reg<(pointer_int_t(1) << block_a::shift) - 4>::address < block_b::link_base, "last register of block shouldn't alias the next block");
+			static_assert(is_same<block_a::reg<0x10>::traits::space, block_a>::value, "mapped register should be accessed through its block");
+
+			// registers at the same offset of different blocks aren't folded, folding within a block is kept
+			static_assert(settings<block_a::reg<0x10>::bit<0>::high, block_b::reg<0x10>::bit<1>::high, block_a::reg<0x10>::bit<2>::high>::plan::registers == 2, "blocks should be kept apart");
+			static_assert(initializer<block_a::reg<0x10, uint8_t, 0>::bit<0>::high, block_a::reg<0x10, uint8_t, 0>::bit<2>::high>::plan::reads == 0, "mapped register with reset value should be stored");
+			static_assert(!opti_init::detail::is_tabulable<block_a::reg<0x10>::bit<0>::high>::value, "mapped register address isn't constant");
+
+		#if defined(__linux__)
+			// file-backed mapping stands for /dev/uioN, accesses land in the file, or in simulated
+			// register file at mapped addresses; returns number of failed checks
+			inline int run_mapped() {
+				FILE * file = tmpfile();
+				if (!file || ftruncate(fileno(file), 0x1000) != 0)
+					return 1;
+				void * mapping = mmap(0, 0x1000, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+				if (mapping == MAP_FAILED)
+					return 1;
+
+				using block = mapped_block<2>;
+				using control = block::reg<0x10, uint32_t, 0>;
+				using divider = block::reg<0x14, uint32_t>::field<4, 8>;
+				using latch = basic_register<block::reg<0x18>::address, register_traits<register_value_t(~uint32_t(0)), 0, access::shadowed<>, uint32_t, block>>;
+				block::bind(mapping);
+
+				// registers of one block are folded, accessed at bound base
+				initializer< control::bit<0>::high, divider::set<0xCD>, control::bit<8>::high >{};
+				divider::set_f(0xAB);
+
+				// shadowed register is written through at bound base as well
+				settings< latch::bit<3>::high >{};
+
+				uint32_t stored[3] = { 0, 0, 0 };
+			#if defined(OPTI_INIT_SIMULATED)
+				int failed = 0;
+				stored[0] = uint32_t(simulated::registers().value(block::address(control::address)));
+				stored[1] = uint32_t(simulated::registers().value(block::address(control::address + 4)));
+				stored[2] = uint32_t(simulated::registers().value(block::address(latch::address)));
+			#else
+				int failed = pread(fileno(file), stored, sizeof(stored), 0x10) != sizeof(stored);
+			#endif
+				failed += stored[0] != 0x101 || stored[1] != 0xAB0 || stored[2] != 0x8;
+				failed += divider::get_f() != 0xAB;
+
+				munmap(mapping, 0x1000);
+				fclose(file);
+				return failed;
+			}
+		#endif
+		}
+		#endif // OPTI_INIT_TESTS
+
+	} // namespace hardware
+
+} // namespace opti_init
+
+#endif // OPTI_INIT_MAPPED_H
@@ -28,6 +28,14 @@
 #endif
 
 #include "internals.h"
+
+#ifdef OPTI_INIT_SIMULATED
+#include "simulated.h"
+#endif
+
 #include "hardware.h"
+#include "expander.h"
+#include "mapped.h"
+#include "registry.h"
 
 #endif
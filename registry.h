@@ -0,0 +1,253 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_REGISTRY_H
+#define OPTI_INIT_REGISTRY_H
+
+/*
+Initialization spread over several translation units, e.g. firmware
+modules each configuring its own peripherals and pins. Every module
+registers its settings once, in its own source file:
+	OPTI_INIT_REGISTER(motor_pins, motor_timer);
+Folded accesses of the module are put into opti_init_registry linker
+section as (address, mask, value) records, and single boot pass merges
+records of all modules by register:
+	if (!opti_init::registry::perform())
+		... modules set the same bits differently ...
+Registers shared by modules, like a common GPIO port, are accessed once,
+in unspecified order.
+Section bounds are provided by GNU linker, so it's available on ELF
+targets whose constant data is directly addressable; it isn't on AVR.
+*/
+
+#ifndef __AVR__
+
+#define OPTI_INIT_REGISTRY_SECTION __attribute__((section("opti_init_registry"), used))
+
+#define OPTI_INIT_REGISTRY_NAME_(line) opti_init_registered_##line
+#define OPTI_INIT_REGISTRY_NAME(line) OPTI_INIT_REGISTRY_NAME_(line)
+
+/*
+Registers settings of a module, at namespace scope of its source file:
+OPTI_INIT_REGISTER(motor_pins, motor_timer);
+Section attribute is ignored for template instances by some compilers, so
+records are a plain variable, unique within the file.
+*/
+#define OPTI_INIT_REGISTER(...) \
+	alignas(opti_init::detail::registry_record) static const opti_init::registered<__VA_ARGS__>::block \
+		OPTI_INIT_REGISTRY_NAME(__LINE__) OPTI_INIT_REGISTRY_SECTION = opti_init::registered<__VA_ARGS__>::block::make()
+
+namespace opti_init
+{
+	namespace detail
+	{
+		enum registry_policy { registry_read_write, registry_write_one, registry_read_to_clear };
+
+		// bits written by a module along with presumed bits of the register
+		struct registry_record {
+			pointer_int_t address;
+			register_value_t mask;
+			register_value_t value;
+			register_value_t presumed_mask;
+			register_value_t presumed_value;
+			register_value_t flags;
+			uint8_t width;
+			uint8_t policy;
+		};
+
+		// only plain register accesses may be registered
+		template <typename M>
+		struct registry_entry {
+			static_assert(is_tabulable<M>::value, "only modifiers of registers at fixed addresses may be registered");
+		};
+
+		template <pointer_int_t ptr, register_value_t mask, register_value_t val, typename traits>
+		struct registry_entry<modifier<ptr, mask, val, traits>> {
+			static_assert(is_tabulable<modifier<ptr, mask, val, traits>>::value, "only modifiers of registers at fixed addresses may be registered");
+			static_assert(!same_type<typename traits::access_policy, access::read_only>::value, "read-only register can't be written");
+
+			static constexpr registry_record record() {
+				return registry_record{
+					ptr, mask, val, traits::presumed_mask, traits::presumed_value, flag_bits<typename traits::access_policy>::value,
+					uint8_t(sizeof(typename traits::value_type)),
+					uint8_t(is_write_one<typename traits::access_policy>::value ? registry_write_one
+						: same_type<typename traits::access_policy, access::read_to_clear>::value ? registry_read_to_clear
+						: registry_read_write)
+				};
+			}
+		};
+
+		template <typename L>
+		struct registry_block {};
+
+		template <typename ...M>
+		struct registry_block<list<M...>> {
+			static_assert(sizeof...(M) > 0, "nothing to register");
+
+			registry_record records[sizeof...(M)];
+
+			static constexpr registry_block make() {
+				return registry_block{ { registry_entry<M>::record()... } };
+			}
+		};
+
+		inline register_value_t registry_width_mask(unsigned width) {
+			return width >= sizeof(register_value_t) ? register_value_t(~register_value_t(0)) : register_value_t((register_value_t(1) << (8 * width)) - 1);
+		}
+
+		/*
+		Records of every register are merged at its first one. Records are
+		laid out by compiler and linker, so order of registers isn't
+		specified. Bits set by several records should have the same values,
+		register width, access policy and flags should match as well. Flags
+		are written as zero by read-modify-write. Nothing is written unless
+		perform is true.
+		*/
+		__attribute__((noinline)) inline bool run_registry(const registry_record * first, const registry_record * last, bool perform) {
+			for (const registry_record * record = first; record != last; record++) {
+				const registry_record * previous = first;
+				while (previous != record && previous->address != record->address)
+					previous++;
+				if (previous != record)
+					continue;
+
+				register_value_t mask = 0;
+				register_value_t value = 0;
+				for (const registry_record * other = record; other != last; other++) {
+					if (other->address != record->address)
+						continue;
+					if (other->width != record->width || other->policy != record->policy || other->flags != record->flags || (mask & other->mask & (value ^ other->value)))
+						return false;
+					mask |= other->mask;
+					value |= other->value & other->mask;
+				}
+
+				register_value_t full = registry_width_mask(record->width);
+				bool rmw = record->policy != registry_write_one && ((mask | record->presumed_mask) & full) != full;
+				if (rmw && record->policy == registry_read_to_clear)
+					return false;
+				if (!perform)
+					continue;
+
+				if (!rmw && record->policy != registry_write_one)
+					value |= record->presumed_value & ~mask;
+				if (rmw)
+					mask |= record->flags;
+
+				if (record->width == 1)
+					table_access<uint8_t>(record->address, mask, value, rmw);
+				else if (record->width == 2)
+					table_access<uint16_t>(record->address, mask, value, rmw);
+				else if (sizeof(register_value_t) >= 4 && record->width == 4)
+					table_access<uint32_t>(record->address, mask, value, rmw);
+				else if (sizeof(register_value_t) >= 8)
+					table_access<uint64_t>(record->address, mask, value, rmw);
+			}
+			return true;
+		}
+	} // namespace detail
+}
+
+// section bounds defined by linker, once anything is registered
+extern "C" {
+	extern const opti_init::detail::registry_record __start_opti_init_registry[];
+	extern const opti_init::detail::registry_record __stop_opti_init_registry[];
+}
+
+namespace opti_init
+{
+	// settings of a module, folded at compile time, and their records
+	template <typename ...T>
+	struct registered {
+		typedef typename detail::fold_distinct<typename detail::flatten<T...>::type>::type modifiers;
+		typedef detail::registry_block<modifiers> block;
+	};
+
+	// boot pass over records of all registered modules
+	struct registry {
+		static const detail::registry_record * begin() { return __start_opti_init_registry; }
+		static const detail::registry_record * end() { return __stop_opti_init_registry; }
+
+		// one access of every register; false and nothing written if records conflict
+		static bool perform() {
+			return perform(begin(), end());
+		}
+
+		static bool perform(const detail::registry_record * first, const detail::registry_record * last) {
+			return detail::run_registry(first, last, false) && detail::run_registry(first, last, true);
+		}
+	};
+
+	#ifdef OPTI_INIT_TESTS
+	namespace test
+	{
+		struct registry_records
+		{
+			using module = detail::registry_block<list<modifier<0x10, 0x03, 0x01, known_reset<0x80>>, modifier<0x11, 0x01, 0x01, write_one_register>>>;
+
+			// each module is folded on its own, presumed bits are kept apart from written ones
+			static_assert(module::make().records[0].mask == 0x03 && module::make().records[0].value == 0x01, "written bits invalid");
+			static_assert(module::make().records[0].presumed_mask == register_value_t(peripheral_register_t(~0)) && module::make().records[0].presumed_value == 0x80, "presumed bits invalid");
+			static_assert(module::make().records[1].policy == detail::registry_write_one, "access policy invalid");
+		};
+
+	#ifdef OPTI_INIT_SIMULATED
+		// settings of two firmware modules, both writing a common port
+		using motor_module = list< modifier<0x180, 0x03, 0x01, known_reset<0x40>>, modifier<0x18C, 0x01, 0x01> >;
+		using comms_module = list< modifier<0x188, 0xFF, 0xA5, register_traits<0, 0, access::read_write, uint8_t>>, modifier<0x180, 0x30, 0x20, known_reset<0x40>> >;
+
+		// returns number of failed checks
+		inline int run_registry() {
+			using namespace opti_init::simulated;
+			int failed = 0;
+			register_file & file = registers();
+
+			// modules registered in the registry share a register, merged into one store of each register
+			file.reset();
+			failed += !registry::perform();
+			failed += file.value(0x180) != 0x61 || file.value(0x188) != 0xA5 || file.value(0x18C) != 0x01;
+			failed += file.count(read_access) != 1 || file.count(write_access) != 3;
+
+			// conflicting records of a register aren't written at all
+			file.reset();
+			const detail::registry_block<list<modifier<0x190, 0x03, 0x01>, modifier<0x190, 0x06, 0x06>>> conflicting =
+				detail::registry_block<list<modifier<0x190, 0x03, 0x01>, modifier<0x190, 0x06, 0x06>>>::make();
+			failed += registry::perform(conflicting.records, conflicting.records + 2);
+			failed += file.trace().size() != 0;
+
+			file.reset();
+			return failed;
+		}
+	#endif
+	}
+	#endif // OPTI_INIT_TESTS
+}
+
+#if defined(OPTI_INIT_TESTS) && defined(OPTI_INIT_SIMULATED)
+// registered as they would be in their own source files
+OPTI_INIT_REGISTER(opti_init::test::motor_module);
+OPTI_INIT_REGISTER(opti_init::test::comms_module);
+#endif
+
+#endif // __AVR__
+
+#endif // OPTI_INIT_REGISTRY_H
@@ -0,0 +1,372 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_SIMULATED_H
+#define OPTI_INIT_SIMULATED_H
+
+#include <map>
+#include <vector>
+
+namespace opti_init
+{
+	#ifdef OPTI_INIT_TESTS
+	namespace detail
+	{
+		// test port registers are accessed with sbi/cbi, as in AVR lower I/O space
+		template <typename value_type>
+		struct access_cost<0x1A0, value_type> : access_cost<0, value_type> {
+			static const bool single_bit_available = true;
+			static const int single_bit_cycles = 0;
+			static const int single_bit_bytes = 0;
+		};
+
+		template <typename value_type>
+		struct access_cost<0x1A2, value_type> : access_cost<0x1A0, value_type> {};
+	}
+	#endif
+
+	/*
+	Register file in host memory, used instead of peripheral addresses when
+	OPTI_INIT_SIMULATED is defined. Every register access performed by the
+	library is recorded in order, so tests running on a host may check what
+	exactly an initializer does, e.g. that it writes every register once
+	without reading it.
+	*/
+	namespace simulated
+	{
+		enum access_type { read_access, write_access };
+
+		struct access {
+			access_type type;
+			pointer_int_t address;
+			unsigned width;    // in bytes
+			register_value_t value;
+		};
+
+		class register_file {
+		public:
+			register_value_t read(pointer_int_t address, unsigned width) {
+				register_value_t value = this->value(address) & width_mask(width);
+				accesses.push_back(access{read_access, address, width, value});
+				return value;
+			}
+
+			void write(pointer_int_t address, unsigned width, register_value_t value) {
+				value &= width_mask(width);
+				values[address] = value;
+				accesses.push_back(access{write_access, address, width, value});
+			}
+
+			// register contents, without recording an access
+			register_value_t value(pointer_int_t address) const {
+				std::map<pointer_int_t, register_value_t>::const_iterator it = values.find(address);
+				return it == values.end() ? 0 : it->second;
+			}
+
+			// e.g. register reset value, without recording an access
+			void preset(pointer_int_t address, register_value_t value) {
+				values[address] = value;
+			}
+
+			const std::vector<access> & trace() const {
+				return accesses;
+			}
+
+			unsigned count(access_type type) const {
+				unsigned result = 0;
+				for (unsigned i = 0; i < accesses.size(); i++)
+					result += accesses[i].type == type;
+				return result;
+			}
+
+			unsigned count(access_type type, pointer_int_t address) const {
+				unsigned result = 0;
+				for (unsigned i = 0; i < accesses.size(); i++)
+					result += accesses[i].type == type && accesses[i].address == address;
+				return result;
+			}
+
+			void clear_trace() {
+				accesses.clear();
+			}
+
+			// all registers are zero, trace is empty
+			void reset() {
+				values.clear();
+				accesses.clear();
+			}
+
+		private:
+			static register_value_t width_mask(unsigned width) {
+				return width >= sizeof(register_value_t) ? register_value_t(~register_value_t(0)) : register_value_t((register_value_t(1) << (8 * width)) - 1);
+			}
+
+			std::map<pointer_int_t, register_value_t> values;
+			std::vector<access> accesses;
+		};
+
+		// the only register file, shared by all translation units
+		inline register_file & registers() {
+			static register_file file;
+			return file;
+		}
+
+		/*
+		Devices on simulated bus, e.g. I/O expanders: a transport for
+		expander.h which records every transaction, and keeps written
+		register values to be read back.
+		*/
+		struct transaction {
+			access_type type;
+			uint8_t device;
+			uint8_t first_register;
+			std::vector<uint8_t> data;
+		};
+
+		class bus {
+		public:
+			void write(uint8_t device, uint8_t first_register, const uint8_t * data, unsigned count) {
+				transactions.push_back(transaction{write_access, device, first_register, std::vector<uint8_t>(data, data + count)});
+				for (unsigned i = 0; i < count; i++)
+					values[key(device, first_register + i)] = data[i];
+			}
+
+			void read(uint8_t device, uint8_t first_register, uint8_t * data, unsigned count) {
+				for (unsigned i = 0; i < count; i++)
+					data[i] = value(device, first_register + i);
+				transactions.push_back(transaction{read_access, device, first_register, std::vector<uint8_t>(data, data + count)});
+			}
+
+			// register contents, without recording a transaction
+			uint8_t value(uint8_t device, unsigned index) const {
+				std::map<unsigned, uint8_t>::const_iterator it = values.find(key(device, index));
+				return it == values.end() ? 0 : it->second;
+			}
+
+			void preset(uint8_t device, unsigned index, uint8_t value) {
+				values[key(device, index)] = value;
+			}
+
+			const std::vector<transaction> & trace() const {
+				return transactions;
+			}
+
+			unsigned count(access_type type, uint8_t device) const {
+				unsigned result = 0;
+				for (unsigned i = 0; i < transactions.size(); i++)
+					result += transactions[i].type == type && transactions[i].device == device;
+				return result;
+			}
+
+			void reset() {
+				values.clear();
+				transactions.clear();
+			}
+
+		private:
+			static unsigned key(uint8_t device, unsigned index) {
+				return (unsigned(device) << 8) | (index & 0xFF);
+			}
+
+			std::map<unsigned, uint8_t> values;
+			std::vector<transaction> transactions;
+		};
+
+		inline bus & expander_bus() {
+			static bus instance;
+			return instance;
+		}
+
+		struct mock_transport {
+			static void write(uint8_t device, uint8_t first_register, const uint8_t * data, unsigned count) {
+				expander_bus().write(device, first_register, data, count);
+			}
+
+			static void read(uint8_t device, uint8_t first_register, uint8_t * data, unsigned count) {
+				expander_bus().read(device, first_register, data, count);
+			}
+		};
+
+		#ifdef OPTI_INIT_TESTS
+		/*
+		Runtime tests of the folding engine. Tests of other features are next
+		to them, e.g. hardware::test::run_shadowed(); every function returns
+		number of failed checks.
+		*/
+		namespace test
+		{
+			using byte = register_traits<0, 0, opti_init::access::read_write, uint8_t>;
+
+			// port registers accessed with sbi/cbi, see access_cost above
+			static const pointer_int_t io_pin = 0x1A0;
+			static const pointer_int_t io_port = 0x1A2;
+
+			inline int run_folding() {
+				int failed = 0;
+				register_file & file = registers();
+
+				// 3 modifiers of 2 registers with known reset: 2 stores and no reads
+				file.reset();
+				initializer<
+					modifier<0x100, 0x1, 0x1, known_reset<0>>,
+					modifier<0x108, 0x2, 0x2, known_reset<0>>,
+					modifier<0x100, 0x4, 0x4, known_reset<0>>
+				>{};
+				failed += file.count(write_access) != 2;
+				failed += file.count(read_access) != 0;
+				failed += file.value(0x100) != 0x5;
+				failed += file.value(0x108) != 0x2;
+				failed += file.trace()[0].address != 0x100;    // first mentioned is written first
+
+				// unknown register value is read-modify-written
+				file.reset();
+				file.preset(0x110, 0xF0);
+				settings< modifier<0x110, 0x0F, 0x05> >{};
+				failed += file.count(read_access, 0x110) != 1;
+				failed += file.count(write_access, 0x110) != 1;
+				failed += file.value(0x110) != 0xF5;
+
+				// access width follows register width
+				file.reset();
+				initializer< modifier<0x118, 0x8, 0x8, known_reset<0, uint16_t>> >{};
+				failed += file.trace().size() != 1 || file.trace()[0].width != 2;
+
+				// flags cleared by writing one are written as zero by read-modify-write
+				file.reset();
+				file.preset(0x11C, 0x81);
+				settings< modifier<0x11C, 0x02, 0x02, register_traits<0, 0, opti_init::access::read_write_flags<0x80>, uint8_t>> >{};
+				failed += file.count(read_access, 0x11C) != 1;
+				failed += file.trace().back().value != 0x03;
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_dynamic() {
+				int failed = 0;
+				register_file & file = registers();
+
+				// runtime value is ORed into constant bits of the same access
+				file.reset();
+				file.preset(0x128, 0xF00);
+				settings< modifier<0x128, 0x3, 0x1>, dynamic_modifier<0x128, 0x70> >::perform(5);
+				failed += file.count(read_access, 0x128) != 1;
+				failed += file.count(write_access, 0x128) != 1;
+				failed += file.value(0x128) != 0xF51;
+
+				// with known reset value, it's stored without reading
+				file.reset();
+				initializer< dynamic_modifier<0x130, 0xFF, known_reset<0>>, modifier<0x130, 0x100, 0x100, known_reset<0>> >::perform(0x1234);
+				failed += file.count(read_access) != 0;
+				failed += file.value(0x130) != 0x134;
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_table() {
+				int failed = 0;
+				register_file & file = registers();
+
+				// table-driven list does the same accesses, in the same order
+				file.reset();
+				file.preset(0x148, 0xF0);
+				settings<
+					table_driven,
+					modifier<0x148, 0x0F, 0x05, byte>,
+					modifier<0x14A, 0x200, 0x200, known_reset<0, uint16_t>>,
+					modifier<0x14C, 0xFF, 0x12, byte>,
+					dynamic_modifier<0x14D, 0x0F>
+				>::perform(3);
+				failed += file.trace().size() != 7;
+				failed += file.value(0x148) != 0xF5 || file.value(0x14A) != 0x200 || file.value(0x14C) != 0x12 || file.value(0x14D) != 0x3;
+				failed += file.trace()[2].address != 0x14A || file.trace()[2].width != 2;
+				failed += file.count(read_access, 0x14C) != 0;
+
+				// pin toggled by table with sbi on PINx: no other pin is written, though they are high
+				file.reset();
+				file.preset(io_pin, 0xF7);
+				file.preset(io_port, 0xF7);
+				settings< table_driven, modifier<io_pin, 0x08, 0x08, toggle_register>, modifier<io_port, 0x01, 0x00, byte> >{};
+				failed += file.count(read_access, io_pin) != 0;
+				failed += file.count(write_access, io_pin) != 1 || file.value(io_pin) != 0x08;
+				failed += file.value(io_port) != 0xF6;    // sbi/cbi of ordinary register keeps other bits
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_transition() {
+				int failed = 0;
+				register_file & file = registers();
+
+				// transition writes changed registers only, without reading fully known ones
+				file.reset();
+				using run_mode = list< modifier<0x140, 0x1, 0x1, byte>, modifier<0x141, 0xFF, 0x0F, byte>, modifier<0x142, 0x3, 0x1, byte> >;
+				using sleep_mode = list< modifier<0x140, 0x1, 0x1, byte>, modifier<0x141, 0xF0, 0xA0, byte>, modifier<0x142, 0x3, 0x2, byte> >;
+				transition<run_mode, sleep_mode>{};
+				failed += file.count(write_access, 0x140) != 0;
+				failed += file.count(read_access, 0x141) != 0 || file.count(write_access, 0x141) != 1;
+				failed += file.value(0x141) != 0xAF;
+				failed += file.count(read_access, 0x142) != 1 || file.value(0x142) != 0x2;
+
+				file.reset();
+				return failed;
+			}
+
+			inline int run_polling() {
+				int failed = 0;
+				register_file & file = registers();
+
+				// polling reads each register once: conditions met at once, then timed out on the first register
+				file.reset();
+				file.preset(0x170, 0x81);
+				file.preset(0x178, 0x02);
+				using locked = wait_until< modifier<0x170, 0x01, 0x01>, modifier<0x178, 0x02, 0x02>, modifier<0x170, 0x80, 0x80> >;
+				locked{};
+				failed += file.count(read_access) != 2;
+				file.clear_trace();
+				failed += wait_until_timeout< 5, modifier<0x170, 0x02, 0x02>, modifier<0x178, 0x02, 0x02> >::perform();
+				failed += file.count(read_access, 0x170) != 5 || file.count(read_access, 0x178) != 0;
+
+				file.reset();
+				return failed;
+			}
+		}
+		#endif // OPTI_INIT_TESTS
+	} // namespace simulated
+
+	namespace detail
+	{
+
+		inline register_value_t simulated_read(pointer_int_t ptr, unsigned width) {
+			return simulated::registers().read(ptr, width);
+		}
+
+		inline void simulated_write(pointer_int_t ptr, unsigned width, register_value_t value) {
+			simulated::registers().write(ptr, width, value);
+		}
+	}
+
+} // namespace opti_init
+
+#endif // OPTI_INIT_SIMULATED_H
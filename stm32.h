@@ -0,0 +1,312 @@
+/* Efficient and comprehensive MCU peripheral configuration library
+ * Copyright (c) 2019 Anton Konkevych.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OPTI_INIT_STM32_H
+#define OPTI_INIT_STM32_H
+
+namespace opti_init
+{
+	namespace hardware
+	{
+		/*
+		Output value of STM32 pin is always changed with BSRR register: writing
+		one to lower half sets pin, writing one to upper half resets it, zeroes
+		are ignored. So any number of pin values of one port is changed with
+		single store, without reading anything. Pin mentioned again takes the
+		last mentioned value, as set and reset bits of the pin are never
+		stored together.
+		*/
+		template<pointer_int_t ptr_bsrr, pointer_int_t ptr_idr, int bit>
+		struct gpio_value {
+			static constexpr int bit_index = bit;
+			static constexpr int bit_mask = (1 << bit);
+
+			using bsrr_traits = register_traits<0, 0, access::set_reset, uint32_t>;
+
+			using low  = modifier< ptr_bsrr, (1UL << (bit + 16)), (1UL << (bit + 16)), bsrr_traits >;
+			using high = modifier< ptr_bsrr, bit_mask, bit_mask, bsrr_traits >;
+
+			using idr_register_bit = peripheral_register_bit<ptr_idr, bit>;
+
+			template <bool value>
+			using set = typename opti_init::detail::conditional<value, high, low>::type;
+
+			static bool get_f() { return idr_register_bit::get_f(); }
+			static void set_f(bool value) { if (value) high::perform(); else low::perform(); }
+		};
+
+	#if defined(STM32F0)
+		/*
+		STM32F0 pin configuration is dispersed over several registers, with
+		2-bit field (MODER, PUPDR, OSPEEDR) or single bit (OTYPER) per pin.
+		Reset values differ for port A, which has SWD pins configured.
+		*/
+		template<pointer_int_t base, int bit,
+				peripheral_register_t moder_reset = 0,
+				peripheral_register_t ospeedr_reset = 0,
+				peripheral_register_t pupdr_reset = 0>
+		struct gpio : gpio_value<base + 0x18, base + 0x10, bit> {
+			static constexpr pointer_int_t moder = base + 0x00;
+			static constexpr pointer_int_t otyper = base + 0x04;
+			static constexpr pointer_int_t ospeedr = base + 0x08;
+			static constexpr pointer_int_t pupdr = base + 0x0C;
+
+			static constexpr peripheral_register_t field_mask = (3UL << (2 * bit));
+
+			template <peripheral_register_t value>
+			using moder_field = modifier< moder, field_mask, (value << (2 * bit)), known_reset<moder_reset> >;
+
+			template <peripheral_register_t value>
+			using ospeedr_field = modifier< ospeedr, field_mask, (value << (2 * bit)), known_reset<ospeedr_reset> >;
+
+			template <peripheral_register_t value>
+			using pupdr_field = modifier< pupdr, field_mask, (value << (2 * bit)), known_reset<pupdr_reset> >;
+
+			using input_any = moder_field<0>;
+			using output_any = moder_field<1>;
+			using alternate = moder_field<2>;
+			using analog = moder_field<3>;
+
+			using push_pull = modifier< otyper, (1UL << bit), 0, known_reset<0> >;
+			using open_drain = modifier< otyper, (1UL << bit), (1UL << bit), known_reset<0> >;
+
+			using speed_low = ospeedr_field<0>;
+			using speed_medium = ospeedr_field<1>;
+			using speed_high = ospeedr_field<3>;
+
+			using no_pull = pupdr_field<0>;
+			using pull_up = pupdr_field<1>;
+			using pull_down = pupdr_field<2>;
+
+			using low = typename gpio::gpio_value::low;
+			using high = typename gpio::gpio_value::high;
+
+			using output_low = list< low, output_any >;
+			using output_high = list< high, output_any >;
+
+			using input_floating = list< no_pull, input_any >;
+			using input_pullup = list< pull_up, input_any >;
+			using input_pulldown = list< pull_down, input_any >;
+
+			using input = input_floating;
+			using output = output_any;
+		};
+
+		#define __STM32_PORT(X, MODER_RESET, OSPEEDR_RESET, PUPDR_RESET) \
+				template <int index> \
+				struct port##X : gpio<(pointer_int_t)(GPIO##X##_BASE), index, MODER_RESET, OSPEEDR_RESET, PUPDR_RESET> {};
+
+		#ifdef GPIOA_BASE
+			__STM32_PORT(A, 0x28000000, 0x0C000000, 0x24000000);
+		#endif
+
+		#ifdef GPIOB_BASE
+			__STM32_PORT(B, 0, 0, 0);
+		#endif
+
+		#ifdef GPIOC_BASE
+			__STM32_PORT(C, 0, 0, 0);
+		#endif
+
+		#ifdef GPIOD_BASE
+			__STM32_PORT(D, 0, 0, 0);
+		#endif
+
+		#ifdef GPIOE_BASE
+			__STM32_PORT(E, 0, 0, 0);
+		#endif
+
+		#ifdef GPIOF_BASE
+			__STM32_PORT(F, 0, 0, 0);
+		#endif
+
+		#undef __STM32_PORT
+
+	#elif defined(STM32F1)
+		/*
+		STM32F1 pin configuration is a 4-bit field (CNF[1:0], MODE[1:0]) in CRL
+		for pins 0..7 or CRH for pins 8..15. Pull direction of input is selected
+		by output value. All pins are floating inputs after reset.
+		*/
+		template<pointer_int_t base, int bit>
+		struct gpio : gpio_value<base + 0x10, base + 0x08, bit> {
+			static constexpr pointer_int_t cr = base + (bit < 8 ? 0x00 : 0x04);
+
+			static constexpr int field_shift = 4 * (bit % 8);
+			static constexpr peripheral_register_t field_mask = (0xFUL << field_shift);
+
+			// CNF[1:0] and MODE[1:0] bits, as in reference manual
+			template <peripheral_register_t value>
+			using config = modifier< cr, field_mask, (value << field_shift), known_reset<0x44444444> >;
+
+			using analog = config<0x0>;
+			using input_any = config<0x4>;
+			using input_pull = config<0x8>;
+
+			using output_any = config<0x2>;           // push-pull, 2 MHz
+			using output_open_drain = config<0x6>;
+			using alternate = config<0xA>;
+			using alternate_open_drain = config<0xE>;
+
+			using output_10mhz = config<0x1>;
+			using output_50mhz = config<0x3>;
+
+			using low = typename gpio::gpio_value::low;
+			using high = typename gpio::gpio_value::high;
+
+			using output_low = list< low, output_any >;
+			using output_high = list< high, output_any >;
+
+			using input_floating = input_any;
+			using input_pullup = list< high, input_pull >;
+			using input_pulldown = list< low, input_pull >;
+
+			using input = input_floating;
+			using output = output_any;
+		};
+
+		#define __STM32_PORT(X) \
+				template <int index> \
+				struct port##X : gpio<(pointer_int_t)(GPIO##X##_BASE), index> {};
+
+		#ifdef GPIOA_BASE
+			__STM32_PORT(A);
+		#endif
+
+		#ifdef GPIOB_BASE
+			__STM32_PORT(B);
+		#endif
+
+		#ifdef GPIOC_BASE
+			__STM32_PORT(C);
+		#endif
+
+		#ifdef GPIOD_BASE
+			__STM32_PORT(D);
+		#endif
+
+		#ifdef GPIOE_BASE
+			__STM32_PORT(E);
+		#endif
+
+		#ifdef GPIOF_BASE
+			__STM32_PORT(F);
+		#endif
+
+		#ifdef GPIOG_BASE
+			__STM32_PORT(G);
+		#endif
+
+		#undef __STM32_PORT
+
+	#endif // STM32F1
+
+	#if (defined(STM32F0) || defined(STM32F1)) && defined(RCC_BASE)
+		/*
+		Peripheral clock enable bits of RCC, as gates of peripheral
+		configuration, e.g. gated<apb2_clock<14>, usart_config...>. APB enable
+		registers are cleared on reset, AHB one has SRAM and flash interface
+		clocks enabled.
+		*/
+		template <int bit>
+		using ahb_clock = modifier< (pointer_int_t)(RCC_BASE) + 0x14, (1UL << bit), (1UL << bit), known_reset<0x14> >;
+
+		template <int bit>
+		using apb2_clock = modifier< (pointer_int_t)(RCC_BASE) + 0x18, (1UL << bit), (1UL << bit), known_reset<0> >;
+
+		template <int bit>
+		using apb1_clock = modifier< (pointer_int_t)(RCC_BASE) + 0x1C, (1UL << bit), (1UL << bit), known_reset<0> >;
+	#endif
+
+		#ifdef OPTI_INIT_TESTS
+		namespace test
+		{
+			using namespace opti_init::test::utils;
+
+			using value = gpio_value<0x18, 0x10, 3>;
+
+			// output value changes of one port are folded into single BSRR store
+			using bsrr_folded = opti_init::detail::fold_distinct<opti_init::detail::flatten<
+				value::high,
+				gpio_value<0x18, 0x10, 5>::low,
+				gpio_value<0x18, 0x10, 6>::set<1>
+			>::type>::type;
+
+			static_assert(is_same<bsrr_folded, list<
+				modifier<0x18, (1 << 3) | (1UL << 21) | (1 << 6), (1 << 3) | (1UL << 21) | (1 << 6), value::bsrr_traits>
+			>>::value, "BSRR modifiers should be folded together");
+			static_assert(value::high::is_write_only(), "BSRR shouldn't be read");
+
+			// pin mentioned again takes the last mentioned value, set and reset bits aren't stored together
+			static_assert(is_same<opti_init::detail::fold_distinct<list<value::high, value::low>>::type, list<value::low>>::value, "later reset should cancel set");
+			static_assert(is_same<opti_init::detail::fold_distinct<list<value::low, value::high>>::type, list<
+				modifier<0x18, (1 << 3), (1 << 3), value::bsrr_traits>
+			>>::value, "later set should cancel reset");
+
+		#if defined(STM32F0)
+			using pin = gpio<0x100, 3>;
+			using pin_a = gpio<0x200, 3, 0x28000000, 0x0C000000, 0x24000000>;
+
+			static_assert(pin::output_any::mask == (3 << 6), "MODER field mask invalid");
+			static_assert(pin::output_any::value == (1 << 6), "MODER field value invalid");
+			static_assert(pin::pull_down::address == 0x10C, "PUPDR address invalid");
+
+			// mode fields of one port are folded into single MODER access
+			using moder_folded = opti_init::detail::fold_distinct<opti_init::detail::flatten<
+				gpio<0x100, 3>::output_high,
+				gpio<0x100, 4>::input_pullup
+			>::type>::type;
+			static_assert(is_same<moder_folded, list<
+				modifier<0x118, (1 << 3), (1 << 3), pin::bsrr_traits>,
+				modifier<0x100, (3 << 6) | (3 << 8), (1 << 6), known_reset<0>>,
+				modifier<0x10C, (3 << 8), (1 << 8), known_reset<0>>
+			>>::value, "GPIO configuration folded invalid");
+
+			static_assert(pin_a::input_any::presumed::value == 0x28000000, "port A reset value should be presumed");
+		#elif defined(STM32F1)
+			using pin = gpio<0x100, 3>;
+			using pin_high = gpio<0x100, 9>;
+
+			static_assert(pin::output_any::address == 0x100, "CRL address invalid");
+			static_assert(pin_high::output_any::address == 0x104, "CRH address invalid");
+			static_assert(pin_high::output_any::mask == (0xF << 4), "CRH field mask invalid");
+			static_assert(pin::output_any::presumed::value == 0x44442444, "CRL reset value should be presumed");
+			static_assert(is_same<pin::input_pullup, list<modifier<0x110, (1 << 3), (1 << 3), pin::bsrr_traits>, pin::input_pull>>::value, "pull-up should be selected with BSRR");
+		#endif
+
+		#if (defined(STM32F0) || defined(STM32F1)) && defined(RCC_BASE)
+			// clocks of two components are enabled with single store, before configuration
+			using clocked = initializer<
+				gated<apb2_clock<2>, pin::output_any>,
+				gated<apb2_clock<12>, modifier<0x200, 0x40, 0x40, known_reset<0>>>
+			>;
+			static_assert(clocked::plan::registers == 3 && clocked::plan::reads == 0, "clock gates should be folded");
+			static_assert(opti_init::detail::head<clocked::plan::modifiers>::type::value == ((1 << 2) | (1 << 12)), "clocks should be enabled first");
+		#endif
+		}
+		#endif // OPTI_INIT_TESTS
+
+	} // namespace hardware
+
+} // namespace opti_init
+
+#endif // OPTI_INIT_STM32_H
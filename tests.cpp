@@ -1,3 +1,23 @@
 #define OPTI_INIT_TESTS
 #include "opti_init.h"
-int main(){};
+int main(){
+	using namespace opti_init;
+	int failed = 0;
+#ifdef OPTI_INIT_SIMULATED
+	failed += simulated::test::run_folding();
+	failed += simulated::test::run_dynamic();
+	failed += simulated::test::run_table();
+	failed += simulated::test::run_transition();
+	failed += simulated::test::run_polling();
+	failed += hardware::test::run_registers();
+	failed += hardware::test::run_shadowed();
+	failed += hardware::test::run_flags();
+	failed += hardware::test::run_pin_bus();
+	failed += hardware::test::run_expander();
+	failed += test::run_registry();
+#endif
+#if defined(__linux__)
+	failed += hardware::test::run_mapped();
+#endif
+	return failed;
+};
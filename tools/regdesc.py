@@ -0,0 +1,514 @@
+#!/usr/bin/env python3
+"""Register description generator for opti_init.
+
+Reads vendor device description, ATDF (AVR) or CMSIS-SVD (ARM), and writes
+a header declaring every register as hardware::basic_register with address,
+width, reset value and access policy taken from the description, and its
+bit fields as register fields, with enumerated values as enum classes:
+
+    opti_init::device::atmega328p::tc0::tccr0b::cs0::set<
+        opti_init::device::atmega328p::tc0::tccr0b::cs0_values::running_clk_64>
+
+Peripherals are namespaces, registers and fields are lowercase, so that they
+don't collide with vendor header macros. Description of AVR doesn't tell
+which registers are cleared by writing one, they are recognized by name
+(--write-one), and so are flags cleared by writing one within ordinary
+registers, like ADIF of ADCSRA (--flags). Such flags are written as zero by
+read-modify-write. Write-only registers are taken as action registers, like
+STM32 BSRR, and written with ones only; latches that keep written bits are
+shadowed if their names are given (--shadowed). --check generates headers
+for sample descriptions in tools/samples and compiles them.
+
+    tools/regdesc.py ATmega328P.atdf -o include
+    tools/regdesc.py STM32F103.svd -o include --name stm32f103
+    tools/regdesc.py --check
+"""
+
+import argparse
+import keyword
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import xml.etree.ElementTree as ET
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SAMPLES = os.path.join(ROOT, "tools", "samples")
+
+# interrupt flag registers of AVR, cleared by writing one
+AVR_WRITE_ONE = r"^(T|E|PC|G|SPM)?IFR\d*$|^INTFLAGS$"
+
+# flags of AVR control registers, as REGISTER.FIELD, cleared by writing one or to be written as zero
+AVR_FLAGS = r"^ADCSRA\.ADIF$|^TWCR\.TWINT$|^UCSR\d*A\.(TXC|FE|DOR|UPE)\d*$"
+
+CPP_KEYWORDS = set("""
+	alignas alignof and and_eq asm auto bitand bitor bool break case catch char
+	char16_t char32_t class compl const constexpr const_cast continue decltype
+	default delete do double dynamic_cast else enum explicit export extern false
+	float for friend goto if inline int long mutable namespace new noexcept not
+	not_eq nullptr operator or or_eq private protected public register
+	reinterpret_cast return short signed sizeof static static_assert static_cast
+	struct switch template this thread_local throw true try typedef typeid
+	typename union unsigned using virtual void volatile wchar_t while xor xor_eq
+	bit set field traits address pointer value_type get_f
+""".split())
+
+VALUE_TYPES = {1: "uint8_t", 2: "uint16_t", 4: "uint32_t", 8: "uint64_t"}
+
+
+def warn(message):
+	print("warning: " + message, file=sys.stderr)
+
+
+class Field:
+	def __init__(self, name, offset, width, description="", write_one=False, values=(), values_name=None):
+		self.name = name
+		self.offset = offset
+		self.width = width
+		self.description = description
+		self.write_one = write_one
+		self.values = list(values)    # (name, value, description)
+		self.values_name = values_name  # shared by field array
+
+
+class Register:
+	def __init__(self, name, address, size, reset=None, reset_mask=None, access="read-write", description="", fields=()):
+		self.name = name
+		self.address = address
+		self.size = size              # bytes
+		self.reset = reset
+		self.reset_mask = reset_mask  # None: all bits of known reset
+		self.access = access          # read-write, read-only, write-only, write-one, read-clear, latch
+		self.description = description
+		self.fields = list(fields)
+
+
+class Peripheral:
+	def __init__(self, name, description="", registers=()):
+		self.name = name
+		self.description = description
+		self.registers = list(registers)
+
+
+def number(text):
+	"""Integer in SVD/ATDF notation: decimal, 0x hex, 0b or # binary"""
+	text = text.strip().lower()
+	if text.startswith("#"):
+		return int(text[1:], 2)
+	if text.startswith("0b"):
+		return int(text[2:], 2)
+	return int(text, 0)
+
+
+def identifier(name):
+	name = re.sub(r"\W", "_", name.strip()).lower()
+	if not name or name[0].isdigit():
+		name = "value_" + name
+	if name in CPP_KEYWORDS or keyword.iskeyword(name):
+		name += "_"
+	return name
+
+
+def text(element, tag, default=None):
+	child = element.find(tag)
+	if child is None or child.text is None:
+		return default
+	return " ".join(child.text.split())
+
+
+def mask_range(mask):
+	"""(offset, width) of contiguous mask, None otherwise"""
+	if mask == 0:
+		return None
+	offset = (mask & -mask).bit_length() - 1
+	width = (mask >> offset).bit_length()
+	if mask != ((1 << width) - 1) << offset:
+		return None
+	return offset, width
+
+
+# ATDF
+
+def parse_atdf(path, write_one, flags):
+	root = ET.parse(path).getroot()
+	device = root.find("devices/device")
+	modules = {module.get("name"): module for module in root.findall("modules/module")}
+
+	peripherals = []
+	for module in device.findall("peripherals/module"):
+		definition = modules.get(module.get("name"))
+		if definition is None:
+			warn("module %s isn't described" % module.get("name"))
+			continue
+		value_groups = {group.get("name"): group for group in definition.findall("value-group")}
+		for instance in module.findall("instance"):
+			peripheral = Peripheral(instance.get("name"), instance.get("caption", ""))
+			for group in instance.findall("register-group"):
+				if group.get("address-space", "data") != "data":
+					continue
+				layout = definition.find("register-group[@name='%s']" % group.get("name-in-module"))
+				if layout is None:
+					warn("register group %s isn't described" % group.get("name-in-module"))
+					continue
+				base = number(group.get("offset", "0"))
+				for register in layout.findall("register"):
+					peripheral.registers.append(atdf_register(register, base, value_groups, write_one, flags))
+			peripherals.append(peripheral)
+	return device.get("name"), peripherals
+
+
+def atdf_register(element, base, value_groups, write_one, flags):
+	name = element.get("name")
+	access = {"R": "read-only", "W": "write-only"}.get(element.get("rw", "RW"), "read-write")
+	if access == "read-write" and re.match(write_one, name):
+		access = "write-one"
+	initval = element.get("initval")
+	register = Register(name, base + number(element.get("offset")), int(element.get("size", "1")),
+		number(initval) if initval is not None else None, None, access, element.get("caption", ""))
+
+	for bitfield in element.findall("bitfield"):
+		mask = number(bitfield.get("mask"))
+		bits = mask_range(mask)
+		if bits is None:
+			warn("%s.%s mask 0x%X isn't contiguous, skipped" % (name, bitfield.get("name"), mask))
+			continue
+		values = []
+		group = value_groups.get(bitfield.get("values"))
+		if group is not None:
+			values = [(value.get("name"), number(value.get("value")), value.get("caption", "")) for value in group.findall("value")]
+		flag = re.match(flags, "%s.%s" % (name, bitfield.get("name"))) is not None
+		register.fields.append(Field(bitfield.get("name"), bits[0], bits[1], bitfield.get("caption", ""), flag, values))
+	return register
+
+
+# SVD
+
+SVD_DEFAULTS = ("size", "access", "resetValue", "resetMask")
+
+
+def inherit(element, defaults):
+	result = dict(defaults)
+	for tag in SVD_DEFAULTS:
+		value = text(element, tag)
+		if value is not None:
+			result[tag] = value
+	return result
+
+
+def dim_names(element, name):
+	"""Names and address increments of dim array"""
+	if text(element, "dim") is None:
+		return [(name, 0)]
+	count = number(text(element, "dim"))
+	increment = number(text(element, "dimIncrement", "0"))
+	index = text(element, "dimIndex")
+	if index is None:
+		indices = [str(i) for i in range(count)]
+	elif "-" in index and "," not in index:
+		first, last = index.split("-")
+		if first.isdigit():
+			indices = [str(i) for i in range(int(first), int(last) + 1)]
+		else:
+			indices = [chr(c) for c in range(ord(first), ord(last) + 1)]
+	else:
+		indices = index.split(",")
+	name = name.replace("[%s]", "%s")
+	return [(name.replace("%s", i.strip()), n * increment) for n, i in enumerate(indices[:count])]
+
+
+def bit_range(element):
+	if text(element, "bitOffset") is not None:
+		return number(text(element, "bitOffset")), number(text(element, "bitWidth", "1"))
+	if text(element, "lsb") is not None:
+		lsb, msb = number(text(element, "lsb")), number(text(element, "msb"))
+		return lsb, msb - lsb + 1
+	match = re.match(r"\[(\w+):(\w+)\]", text(element, "bitRange", ""))
+	if match is None:
+		raise ValueError("field %s has no bit range" % text(element, "name"))
+	msb, lsb = number(match.group(1)), number(match.group(2))
+	return lsb, msb - lsb + 1
+
+
+def svd_fields(element):
+	fields = []
+	for field in element.findall("fields/field"):
+		offset, width = bit_range(field)
+		write_one = text(field, "modifiedWriteValues") == "oneToClear"
+		values = []
+		for value in field.findall("enumeratedValues/enumeratedValue"):
+			if text(value, "value") is None:
+				continue  # isDefault
+			try:
+				values.append((text(value, "name"), number(text(value, "value")), text(value, "description", "")))
+			except ValueError:
+				warn("%s value %s has don't care bits, skipped" % (text(field, "name"), text(value, "value")))
+		names = dim_names(field, text(field, "name"))
+		values_name = identifier(re.sub(r"\[?%s\]?", "", text(field, "name"))) if len(names) > 1 else None
+		for name, step in names:
+			fields.append(Field(name, offset + step, width, text(field, "description", ""), write_one, values, values_name))
+	return fields
+
+
+def svd_registers(parent, base, defaults, prefix=""):
+	registers = []
+	for element in parent.findall("registers/register"):
+		attributes = inherit(element, defaults)
+		offset = number(text(element, "addressOffset"))
+		access = attributes.get("access", "read-write")
+		fields = svd_fields(element)
+		writable = [field for field in fields if not field.write_one]
+		if fields and not writable or text(element, "modifiedWriteValues") == "oneToClear":
+			access = "write-one"
+		elif text(element, "readAction") == "clear" and access == "read-write":
+			access = "read-clear"
+		elif access in ("writeOnce", "read-writeOnce"):
+			access = "write-only" if access == "writeOnce" else "read-write"
+		size = number(attributes.get("size", "32")) // 8
+		reset = number(attributes["resetValue"]) if "resetValue" in attributes else None
+		reset_mask = number(attributes["resetMask"]) if "resetMask" in attributes else None
+		for name, step in dim_names(element, text(element, "name")):
+			registers.append(Register(prefix + name, base + offset + step, size, reset, reset_mask, access,
+				text(element, "description", ""), fields))
+	for cluster in parent.findall("registers/cluster"):
+		warn("cluster %s isn't supported, skipped" % text(cluster, "name"))
+	return registers
+
+
+def parse_svd(path):
+	root = ET.parse(path).getroot()
+	defaults = inherit(root, {})
+	elements = {text(element, "name"): element for element in root.findall("peripherals/peripheral")}
+
+	peripherals = []
+	for name, element in elements.items():
+		base = number(text(element, "baseAddress"))
+		layout = element
+		if element.get("derivedFrom") is not None and element.find("registers") is None:
+			layout = elements[element.get("derivedFrom")]
+		description = text(element, "description") or text(layout, "description", "")
+		attributes = inherit(layout, defaults)
+		attributes = inherit(element, attributes)
+		peripherals.append(Peripheral(name, description, svd_registers(layout, base, attributes)))
+	return text(root, "name"), peripherals
+
+
+# header
+
+def register_traits(register):
+	"""Traits of register: width, known reset bits and access policy"""
+	value_type = VALUE_TYPES[register.size]
+	full = (1 << (8 * register.size)) - 1
+	reset = (register.reset or 0) & full
+	mask = full if register.reset_mask is None else register.reset_mask & full
+	if register.reset is None:
+		mask = 0
+
+	digits = 2 * register.size
+	# write-one fields of ordinary register, written as zero by read-modify-write
+	flags = 0
+	for field in register.fields:
+		if field.write_one:
+			flags |= ((1 << field.width) - 1) << field.offset
+	flags &= full
+
+	if register.access in ("write-one", "write-only"):
+		return "register_traits<0, 0, access::write_one, %s>" % value_type
+	if register.access == "read-only":
+		return "register_traits<0, 0, access::read_only, %s>" % value_type
+	if register.access == "latch":
+		return "shadowed_traits<0x%0*X, false, %s>" % (digits, reset, value_type)
+	policy = "access::read_to_clear" if register.access == "read-clear" else "access::read_write"
+	if flags and policy == "access::read_write":
+		policy = "access::read_write_flags<0x%0*X>" % (digits, flags)
+	if mask == full and policy == "access::read_write":
+		return "known_reset<0x%0*X, %s>" % (digits, reset, value_type)
+	if mask == 0:
+		return "register_traits<0, 0, %s, %s>" % (policy, value_type)
+	return "register_traits<0x%0*X, 0x%0*X, %s, %s>" % (digits, mask, digits, reset & mask, policy, value_type)
+
+
+def comment(description):
+	description = " ".join(description.split())
+	return (" // " + description) if description else ""
+
+
+def unique(names):
+	seen = {}
+	result = []
+	for name in names:
+		count = seen.get(name, 0)
+		seen[name] = count + 1
+		result.append(name if count == 0 else "%s_%d" % (name, count))
+	return result
+
+
+def emit_register(register, indent):
+	lines = []
+	name = identifier(register.name)
+	traits = register_traits(register)
+	note = comment(register.description)
+	if not register.fields:
+		lines.append("%sstruct %s : hardware::basic_register<0x%X, %s> {};%s" % (indent, name, register.address, traits, note))
+		return lines
+
+	if note:
+		lines.append(indent + note.strip())
+	lines.append("%sstruct %s : hardware::basic_register<0x%X, %s> {" % (indent, name, register.address, traits))
+	enums = set()
+	for field in sorted(register.fields, key=lambda field: -field.offset):
+		field_name = identifier(field.name)
+		if field_name == name:
+			field_name += "_field"
+		values = [(name_, value, description) for name_, value, description in field.values if value < (1 << field.width)]
+		if len(values) != len(field.values):
+			warn("%s.%s has values not fitting into field, skipped" % (register.name, field.name))
+		enum = ""
+		if values:
+			enum = ", %s_values" % (field.values_name or field_name)
+		if values and enum not in enums:
+			enums.add(enum)
+			lines.append("%s\tenum class %s : register_value_t {" % (indent, enum[2:]))
+			value_names = unique([identifier(value[0]) for value in values])
+			for value_name, (_, value, description) in zip(value_names, values):
+				lines.append("%s\t\t%s = 0x%X,%s" % (indent, value_name, value, comment(description)))
+			lines.append("%s\t};" % indent)
+		lines.append("%s\tusing %s = field<%d, %d%s>;%s" % (indent, field_name, field.offset, field.width, enum, comment(field.description)))
+	lines.append("%s};" % indent)
+	return lines
+
+
+def emit(device, source, peripherals):
+	guard = "OPTI_INIT_DEVICE_%s_H" % re.sub(r"\W", "_", device).upper()
+	lines = [
+		"/* Registers of %s, generated by tools/regdesc.py" % device,
+		" * from %s. Don't edit." % os.path.basename(source),
+		" */",
+		"",
+		"#ifndef " + guard,
+		"#define " + guard,
+		"",
+		'#include "opti_init.h"',
+		"",
+		"namespace opti_init",
+		"{",
+		"\tnamespace device",
+		"\t{",
+		"\t\tnamespace %s" % identifier(device),
+		"\t\t{",
+	]
+	for index, peripheral in enumerate(sorted(peripherals, key=lambda peripheral: peripheral.name)):
+		if index:
+			lines.append("")
+		lines.append("\t\t\t// " + (peripheral.description or peripheral.name))
+		lines.append("\t\t\tnamespace %s" % identifier(peripheral.name))
+		lines.append("\t\t\t{")
+		for register in sorted(peripheral.registers, key=lambda register: register.address):
+			lines.extend(emit_register(register, "\t\t\t\t"))
+		lines.append("\t\t\t}")
+	lines += [
+		"\t\t}",
+		"\t}",
+		"}",
+		"",
+		"#endif // " + guard,
+		"",
+	]
+	return "\n".join(lines)
+
+
+def generate(source, output, name=None, write_one=AVR_WRITE_ONE, shadowed=None, flags=AVR_FLAGS):
+	if source.lower().endswith(".atdf"):
+		device, peripherals = parse_atdf(source, write_one, flags)
+	else:
+		device, peripherals = parse_svd(source)
+	# a RAM copy of an action register would write stale actions again
+	for peripheral in peripherals:
+		for register in peripheral.registers:
+			if register.access == "write-only" and shadowed and re.match(shadowed, register.name):
+				register.access = "latch"
+	device = name or device
+	path = os.path.join(output, identifier(device) + ".h")
+	with open(path, "w") as f:
+		f.write(emit(device, source, peripherals))
+	return path
+
+
+# self-check against samples
+
+CHECK_DRIVER = r'''
+#define OPTI_INIT_TESTS
+#include "atmega328p.h"
+#include "sample_cm4.h"
+
+namespace avr = opti_init::device::atmega328p;
+namespace cm4 = opti_init::device::sample_cm4;
+using opti_init::test::utils::is_same;
+
+static_assert(avr::portb::portb::address == 0x25, "register address invalid");
+static_assert(avr::portb::ddrb::traits::presumed_value == 0 && avr::portb::ddrb::traits::presumed_mask == 0xFF, "reset value should be known");
+static_assert(avr::portb::pinb::traits::presumed_mask == 0, "reset value should be unknown without initval");
+static_assert(is_same<avr::tc0::tifr0::traits::access_policy, opti_init::access::write_one>::value, "flag register should be written with ones");
+static_assert(is_same<avr::tc1::ocr1a::value_type, uint16_t>::value, "register width invalid");
+static_assert(is_same<avr::tc0::tccr0b::cs0::set<avr::tc0::tccr0b::cs0_values::running_clk_64>,
+	opti_init::modifier<0x45, 0x07, 0x03, opti_init::known_reset<0, uint8_t>>>::value, "enum field invalid");
+static_assert(avr::tc0::tccr0a::com0a::mask == 0xC0, "field mask invalid");
+static_assert(avr::tc0::tccr0b::foc0a::mask == 0x80, "single bit field invalid");
+
+static_assert(cm4::gpiob::moder::address == 0x48000400, "derived peripheral address invalid");
+static_assert(cm4::gpioa::moder::traits::presumed_value == 0x28000000, "register reset value invalid");
+static_assert(cm4::gpioa::moder::moder15::mask == 0xC0000000UL, "field array invalid");
+static_assert(cm4::gpioa::idr::traits::presumed_mask == 0, "reset mask should be applied");
+static_assert(is_same<cm4::gpioa::idr::traits::access_policy, opti_init::access::read_only>::value, "read-only register shouldn't be written");
+static_assert(is_same<cm4::tc0::evstat::traits::access_policy, opti_init::access::read_to_clear>::value, "read-clear register shouldn't be read-modify-written");
+static_assert(is_same<avr::tc0::tifr0::set<0, true>::presumed, avr::tc0::tifr0::set<0, true>>::value, "flag register shouldn't presume other flags");
+static_assert(is_same<cm4::gpioa::bsrr::traits::access_policy, opti_init::access::write_one>::value, "write-only register should be written with ones");
+static_assert(opti_init::detail::is_shadowed<cm4::tc0::perbuf::traits::access_policy>::value && cm4::tc0::perbuf::traits::presumed_value == 0xFFFF, "listed latch should be shadowed");
+static_assert(cm4::gpioa::bsrr::br::mask == 0xFFFF0000UL && cm4::gpioa::bsrr::bs::mask == 0xFFFF, "bit range invalid");
+static_assert(is_same<cm4::tc0::intflag::traits::access_policy, opti_init::access::write_one>::value, "oneToClear register should be written with ones");
+static_assert(is_same<cm4::tc0::status::traits::access_policy, opti_init::access::read_write_flags<0x18>>::value, "oneToClear fields of ordinary register should be written as zero");
+static_assert(is_same<avr::adc::adcsra::traits, opti_init::register_traits<0xFF, 0x00, opti_init::access::read_write_flags<0x10>, uint8_t>>::value, "ADIF should be written as zero");
+static_assert(cm4::tc0::cc1::address == 0x4000101A, "register array invalid");
+static_assert(cm4::tc0::ctrla::prescaler::set<cm4::tc0::ctrla::prescaler_values::div64>::value == 0x500, "enum field invalid");
+
+int main() { return 0; }
+'''
+
+
+def check(cxx):
+	with tempfile.TemporaryDirectory() as tmp:
+		for source in sorted(os.listdir(SAMPLES)):
+			print(generate(os.path.join(SAMPLES, source), tmp, None if "svd" in source else "atmega328p", shadowed=r"^PERBUF$"))
+		driver = os.path.join(tmp, "check.cpp")
+		with open(driver, "w") as f:
+			f.write(CHECK_DRIVER)
+		for standard in ("c++11", "c++17"):
+			result = subprocess.run([cxx, "-std=" + standard, "-Wall", "-fsyntax-only", "-I" + ROOT, "-I" + tmp, driver])
+			if result.returncode != 0:
+				return result.returncode
+	print("ok")
+	return 0
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("source", nargs="?", help="ATDF or SVD file")
+	parser.add_argument("-o", "--output", default=".", help="directory of generated header")
+	parser.add_argument("--name", help="device name, default: from description")
+	parser.add_argument("--write-one", default=AVR_WRITE_ONE, help="regex of ATDF registers cleared by writing one")
+	parser.add_argument("--flags", default=AVR_FLAGS, help="regex of ATDF REGISTER.FIELD flags cleared by writing one within ordinary registers")
+	parser.add_argument("--shadowed", help="regex of write-only latch registers, shadowed instead of written with ones")
+	parser.add_argument("--check", action="store_true", help="generate and compile sample descriptions")
+	parser.add_argument("--cxx", default=os.environ.get("CXX", "g++"))
+	args = parser.parse_args()
+
+	if args.check:
+		return check(args.cxx)
+	if not args.source:
+		parser.error("source is required")
+	print(generate(args.source, args.output, args.name, args.write_one, args.shadowed, args.flags))
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())